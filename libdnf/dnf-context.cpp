@@ -221,6 +221,16 @@ dnf_context_rpmdb_changed_cb(GFileMonitor *monitor_,
                              GFileMonitorEvent event_type,
                              DnfContext *context)
 {
+    DnfContextPrivate *priv = GET_PRIVATE(context);
+    g_autoptr(GError) error = NULL;
+
+    /* follow the rpmdb in place, unless our own transaction is still writing it */
+    if (priv->sack != NULL &&
+        (dnf_lock_get_state(priv->lock) & (1 << DNF_LOCK_TYPE_RPMDB)) == 0 &&
+        !dnf_context_reload_system_repo(context, &error))
+        g_warning("failed to reload the installed packages: %s", error->message);
+
+    /* packages taken from the sack before may now refer to other packages */
     dnf_context_invalidate(context, "rpmdb changed");
 }
 
@@ -1922,7 +1932,7 @@ dnf_context_setup_sack_with_flags(DnfContext               *context,
     if (!skip_rpmdb && have_existing_install(context)) {
         if (!dnf_sack_load_system_repo(priv->sack,
                                        nullptr,
-                                       DNF_SACK_LOAD_FLAG_NONE,
+                                       DNF_SACK_LOAD_FLAG_BUILD_CACHE,
                                        error))
             return FALSE;
     }
@@ -1970,6 +1980,49 @@ dnf_context_setup_sack_with_flags(DnfContext               *context,
     return TRUE;
 } CATCH_TO_GERROR(FALSE)
 
+/**
+ * dnf_context_reload_system_repo:
+ * @context: a #DnfContext instance.
+ * @error: A #GError or %NULL
+ *
+ * Refreshes the installed packages of a sack set up earlier, for instance
+ * after the rpmdb changed, while the available repos stay loaded. This is
+ * much cheaper than dnf_context_setup_sack() for long running processes.
+ *
+ * The goal returned by dnf_context_get_goal() stays valid but is reset.
+ * Packages, package sets and queries taken from the sack before must not be
+ * used anymore: the new installed packages reuse the ids of the old ones, see
+ * dnf_sack_reload_system_repo(). The includepkgs and excludepkgs of the main
+ * configuration are applied to the new installed packages. Without a sack
+ * the sack is set up from scratch.
+ *
+ * This is what happens when the monitored rpmdb changes, the "invalidate"
+ * signal is emitted afterwards so that consumers drop the packages they hold.
+ *
+ * Returns: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.74.0
+ **/
+gboolean
+dnf_context_reload_system_repo(DnfContext *context, GError **error) try
+{
+    DnfContextPrivate *priv = GET_PRIVATE(context);
+
+    if (priv->sack == nullptr)
+        return dnf_context_setup_sack(context, dnf_context_get_state(context), error);
+    if (!have_existing_install(context))
+        return TRUE;
+    if (!dnf_sack_reload_system_repo(priv->sack, error))
+        return FALSE;
+
+    /* the goal may refer to the old installed packages, callers may hold it */
+    if (priv->goal != nullptr)
+        priv->goal->reset();
+    else
+        priv->goal = hy_goal_create(priv->sack);
+    return TRUE;
+} CATCH_TO_GERROR(FALSE)
+
 /**
  * dnf_context_ensure_exists:
  **/
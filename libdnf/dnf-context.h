@@ -233,6 +233,8 @@ gboolean         dnf_context_setup_sack_with_flags      (DnfContext      *contex
                                                          DnfState        *state,
                                                          DnfContextSetupSackFlags flags,
                                                          GError          **error);
+gboolean         dnf_context_reload_system_repo         (DnfContext     *context,
+                                                         GError         **error);
 gboolean         dnf_context_commit                     (DnfContext     *context,
                                                          DnfState       *state,
                                                          GError         **error);
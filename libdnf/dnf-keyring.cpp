@@ -30,6 +30,7 @@
  */
 
 
+#include <mutex>
 #include <stdlib.h>
 #include <glib.h>
 #include <rpm/rpmlib.h>
@@ -207,10 +208,20 @@ dnf_keyring_add_public_keys(rpmKeyring keyring, GError **error) try
     return TRUE;
 } CATCH_TO_GERROR(FALSE)
 
+/* rpm has a single process-wide log callback, so each verifying thread
+ * points its own slot at the string collecting its messages */
+static thread_local GString **rpm_error_slot = NULL;
+static std::mutex rpm_log_mutex;
+static guint rpm_log_users = 0;
+
 static int
 rpmcliverifysignatures_log_handler_cb(rpmlogRec rec, rpmlogCallbackData data)
 {
-    GString **string =(GString **) data;
+    GString **string = rpm_error_slot;
+
+    /* not a verification running in this thread */
+    if (string == NULL)
+        return 0;
 
     /* create string if required */
     if (*string == NULL)
@@ -227,8 +238,27 @@ rpmcliverifysignatures_log_handler_cb(rpmlogRec rec, rpmlogCallbackData data)
     return 0;
 }
 
+static void
+dnf_keyring_log_callback_ref(void)
+{
+    std::lock_guard<std::mutex> guard(rpm_log_mutex);
+    if (rpm_log_users++ == 0)
+        rpmlogSetCallback(rpmcliverifysignatures_log_handler_cb, NULL);
+}
+
+static void
+dnf_keyring_log_callback_unref(void)
+{
+    std::lock_guard<std::mutex> guard(rpm_log_mutex);
+    if (--rpm_log_users == 0)
+        rpmlogSetCallback(NULL, NULL);
+}
+
 /**
  * dnf_keyring_check_untrusted_file:
+ *
+ * This may be called from several threads at once as long as they
+ * share nothing but @keyring.
  */
 gboolean
 dnf_keyring_check_untrusted_file(rpmKeyring keyring,
@@ -272,7 +302,8 @@ dnf_keyring_check_untrusted_file(rpmKeyring keyring,
         goto out;
     }
     rpmtsSetVfyLevel(ts, RPMSIG_SIGNATURE_TYPE);
-    rpmlogSetCallback(rpmcliverifysignatures_log_handler_cb, &rpm_error);
+    rpm_error_slot = &rpm_error;
+    dnf_keyring_log_callback_ref();
 
     // rpm doesn't provide any better API call than rpmcliVerifySignatures (which is for CLI):
     // - use path_array as input argument
@@ -304,7 +335,10 @@ dnf_keyring_check_untrusted_file(rpmKeyring keyring,
     g_debug("%s has been verified as trusted", filename);
     ret = TRUE;
 out:
-    rpmlogSetCallback(NULL, NULL);
+    if (rpm_error_slot != NULL) {
+        dnf_keyring_log_callback_unref();
+        rpm_error_slot = NULL;
+    }
 
     if (path != NULL)
         g_free(path);
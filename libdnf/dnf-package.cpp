@@ -821,52 +821,15 @@ dnf_package_array_download(GPtrArray *packages,
                 GError **error) try
 {
     DnfState *state_local;
-    GHashTableIter hiter;
-    gpointer key, value;
-    guint i;
-    g_autoptr(GHashTable) repo_to_packages = NULL;
 
-    /* map packages to repos */
-    repo_to_packages = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)g_ptr_array_unref);
-    for (i = 0; i < packages->len; i++) {
-        DnfPackage *pkg = (DnfPackage*)g_ptr_array_index(packages, i);
-        DnfRepo *repo;
-        GPtrArray *repo_packages;
-
-        repo = dnf_package_get_repo(pkg);
-        if (repo == NULL) {
-            g_set_error_literal(error,
-                                DNF_ERROR,
-                                DNF_ERROR_INTERNAL_ERROR,
-                                "package repo is unset");
-            return FALSE;
-        }
-        repo_packages = (GPtrArray*)g_hash_table_lookup(repo_to_packages, repo);
-        if (repo_packages == NULL) {
-            repo_packages = g_ptr_array_new();
-            g_hash_table_insert(repo_to_packages, repo, repo_packages);
-        }
-        g_ptr_array_add(repo_packages, pkg);
-    }
-
-    /* set steps according to the number of repos we are going to download from */
-    dnf_state_set_number_steps(state, g_hash_table_size(repo_to_packages));
-
-    /* download all packages from each repo in one go */
-    g_hash_table_iter_init(&hiter, repo_to_packages);
-    while (g_hash_table_iter_next(&hiter, &key, &value)) {
-        DnfRepo *repo = (DnfRepo*)key;
-        GPtrArray *repo_packages = (GPtrArray*)value;
-
-        state_local = dnf_state_get_child(state);
-        if (!dnf_repo_download_packages(repo, repo_packages, directory, state_local, error))
-            return FALSE;
+    /* download the packages of all repos in one go rather than repo after repo */
+    dnf_state_set_number_steps(state, 1);
+    state_local = dnf_state_get_child(state);
+    if (!dnf_repo_download_packages_from_repos(packages, directory, state_local, error))
+        return FALSE;
 
-        /* done */
-        if (!dnf_state_done(state, error))
-            return FALSE;
-    }
-    return TRUE;
+    /* done */
+    return dnf_state_done(state, error);
 } CATCH_TO_GERROR(FALSE)
 
 /**
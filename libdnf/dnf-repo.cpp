@@ -60,6 +60,7 @@
 #include "utils/url-encode.hpp"
 #include "utils/utils.hpp"
 
+#include <algorithm>
 #include <set>
 #include <string>
 #include <vector>
@@ -85,6 +86,8 @@ typedef struct
     LrHandle        *repo_handle;
     LrResult        *repo_result;
     LrUrlVars       *urlvars;
+    long             max_parallel_downloads;    /* as set on repo_handle */
+    long             max_downloads_per_mirror;  /* as set on repo_handle */
     bool            unit_test_mode;  /* ugly hack for unit tests */
 } DnfRepoPrivate;
 
@@ -134,6 +137,8 @@ dnf_repo_init(DnfRepo *repo)
     priv->repo = hy_repo_create("<preinit>");
     priv->repo_handle = lr_handle_init();
     priv->repo_result = lr_result_init();
+    priv->max_parallel_downloads = LRO_MAXPARALLELDOWNLOADS_DEFAULT;
+    priv->max_downloads_per_mirror = LRO_MAXDOWNLOADSPERMIRROR_DEFAULT;
 }
 
 /**
@@ -2226,6 +2231,158 @@ dnf_repo_download_package(DnfRepo *repo,
     return g_build_filename(directory, basename, NULL);
 } CATCH_TO_GERROR(NULL)
 
+/* ensure the destination directory of the packages of repo exists and
+ * return it with a trailing slash */
+static gchar *
+dnf_repo_get_download_directory(DnfRepo *repo, const gchar *directory, GError **error)
+{
+    DnfRepoPrivate *priv = GET_PRIVATE(repo);
+    gchar *directory_slash;
+
+    /* ensure we reset the values from the keyfile */
+    if (!dnf_repo_set_keyfile_data(repo, TRUE, error))
+        return NULL;
+
+    /* if nothing specified then use cachedir */
+    if (directory == NULL) {
+        directory_slash = g_build_filename(priv->packages, "/", NULL);
+        if (!g_file_test(directory_slash, G_FILE_TEST_EXISTS)) {
+            if (g_mkdir_with_parents(directory_slash, 0755) != 0) {
+                g_set_error(error,
+                            DNF_ERROR,
+                            DNF_ERROR_INTERNAL_ERROR,
+                            "Failed to create %s",
+                            directory_slash);
+                g_free(directory_slash);
+                return NULL;
+            }
+        }
+    } else {
+        /* librepo uses the GNU basename() function to find out if the
+         * output directory is fully specified as a filename, but
+         * basename needs a trailing '/' to detect it's not a filename */
+        directory_slash = g_build_filename(directory, "/", NULL);
+    }
+    return directory_slash;
+}
+
+static LrPackageTarget *
+dnf_repo_new_package_target(DnfRepo *repo,
+                            DnfPackage *pkg,
+                            const gchar *directory_slash,
+                            DnfState *state,
+                            GlobalDownloadData *global_data,
+                            GError **error)
+{
+    DnfRepoPrivate *priv = GET_PRIVATE(repo);
+    PackageDownloadData *data;
+    LrPackageTarget *target;
+    const unsigned char *checksum;
+    int checksum_type;
+    g_autofree char *checksum_str = NULL;
+
+    g_debug("downloading %s to %s",
+            dnf_package_get_location(pkg),
+            directory_slash);
+
+    data = g_slice_new0(PackageDownloadData);
+    data->pkg = pkg;
+    data->state = state;
+    data->global_download_data = global_data;
+
+    checksum = dnf_package_get_chksum(pkg, &checksum_type);
+    checksum_str = hy_chksum_str(checksum, checksum_type);
+
+    std::string encodedUrl = dnf_package_get_location(pkg);
+    if (encodedUrl.find("://") == std::string::npos) {
+        encodedUrl = libdnf::urlEncode(encodedUrl, "/");
+    }
+
+    target = lr_packagetarget_new_v2(priv->repo_handle,
+                                     encodedUrl.c_str(),
+                                     directory_slash,
+                                     dnf_repo_checksum_hy_to_lr(checksum_type),
+                                     checksum_str,
+                                     dnf_package_get_downloadsize(pkg),
+                                     dnf_package_get_baseurl(pkg),
+                                     TRUE,
+                                     package_download_update_state_cb,
+                                     data,
+                                     package_download_end_cb,
+                                     mirrorlist_failure_cb,
+                                     error);
+    if (target == NULL)
+        g_slice_free(PackageDownloadData, data);
+    return target;
+}
+
+static gboolean
+dnf_repo_run_package_targets(GSList *package_targets,
+                             GlobalDownloadData *global_data,
+                             GError **error)
+{
+    g_autoptr(GError) error_local = NULL;
+
+    if (lr_download_packages(package_targets, LR_PACKAGEDOWNLOAD_FAILFAST, &error_local))
+        return TRUE;
+    if (g_error_matches(error_local,
+                        LR_PACKAGE_DOWNLOADER_ERROR,
+                        LRE_ALREADYDOWNLOADED)) {
+        /* ignore */
+        return TRUE;
+    }
+    if (global_data->last_mirror_failure_message) {
+        g_autofree gchar *orig_message = error_local->message;
+        error_local->message = g_strconcat(orig_message, "; Last error: ", global_data->last_mirror_failure_message, NULL);
+    }
+    g_propagate_error(error, error_local);
+    error_local = NULL;
+    return FALSE;
+}
+
+static void
+dnf_repo_reset_progress_cb(DnfRepo *repo)
+{
+    DnfRepoPrivate *priv = GET_PRIVATE(repo);
+
+    if (!lr_handle_setopt(priv->repo_handle, NULL, LRO_PROGRESSCB, NULL))
+            g_debug("Failed to reset LRO_PROGRESSCB to NULL");
+    if (!lr_handle_setopt(priv->repo_handle, NULL, LRO_PROGRESSDATA, 0xdeadbeef))
+            g_debug("Failed to set LRO_PROGRESSDATA to 0xdeadbeef");
+}
+
+/* librepo has no getter for these, so the values are tracked in priv */
+static gboolean
+dnf_repo_set_download_limits(DnfRepo *repo,
+                             long max_parallel_downloads,
+                             long max_downloads_per_mirror,
+                             GError **error)
+{
+    DnfRepoPrivate *priv = GET_PRIVATE(repo);
+
+    if (!lr_handle_setopt(priv->repo_handle, error, LRO_MAXPARALLELDOWNLOADS,
+                          max_parallel_downloads))
+        return FALSE;
+    priv->max_parallel_downloads = max_parallel_downloads;
+    if (!lr_handle_setopt(priv->repo_handle, error, LRO_MAXDOWNLOADSPERMIRROR,
+                          max_downloads_per_mirror))
+        return FALSE;
+    priv->max_downloads_per_mirror = max_downloads_per_mirror;
+    return TRUE;
+}
+
+static void
+dnf_repo_restore_download_limits(DnfRepo *repo,
+                                 long max_parallel_downloads,
+                                 long max_downloads_per_mirror)
+{
+    g_autoptr(GError) error_local = NULL;
+
+    if (!dnf_repo_set_download_limits(repo, max_parallel_downloads,
+                                      max_downloads_per_mirror, &error_local))
+        g_debug("Failed to restore download limits: %s", error_local->message);
+}
+
 /**
  * dnf_repo_download_packages:
  * @repo: a #DnfRepo instance.
@@ -2236,6 +2393,9 @@ dnf_repo_download_package(DnfRepo *repo,
  *
  * Downloads multiple packages from a repo. The target filename will be
  * equivalent to `g_path_get_basename (dnf_package_get_location (pkg))`.
+ * The transfer runs with the max_parallel_downloads and
+ * max_downloads_per_mirror of the repo, the previous limits of its handle
+ * are restored afterwards.
  *
  * Returns: %TRUE for success, %FALSE otherwise
  *
@@ -2248,107 +2408,144 @@ dnf_repo_download_packages(DnfRepo *repo,
                            DnfState *state,
                            GError **error) try
 {
-    DnfRepoPrivate *priv = GET_PRIVATE(repo);
     gboolean ret = FALSE;
     guint i;
     GSList *package_targets = NULL;
     GlobalDownloadData global_data = { 0, };
-    g_autoptr(GError) error_local = NULL;
     g_autofree gchar *directory_slash = NULL;
+    DnfRepoPrivate *priv = GET_PRIVATE(repo);
+    auto conf = priv->repo->getConfig();
+    long prev_max_parallel = priv->max_parallel_downloads;
+    long prev_max_per_mirror = priv->max_downloads_per_mirror;
 
-    /* ensure we reset the values from the keyfile */
-    if (!dnf_repo_set_keyfile_data(repo, TRUE, error))
+    directory_slash = dnf_repo_get_download_directory(repo, directory, error);
+    if (directory_slash == NULL)
+        goto out;
+    if (!dnf_repo_set_download_limits(repo,
+                                      conf->max_parallel_downloads().getValue(),
+                                      conf->max_downloads_per_mirror().getValue(),
+                                      error))
         goto out;
-
-    /* if nothing specified then use cachedir */
-    if (directory == NULL) {
-        directory_slash = g_build_filename(priv->packages, "/", NULL);
-        if (!g_file_test(directory_slash, G_FILE_TEST_EXISTS)) {
-            if (g_mkdir_with_parents(directory_slash, 0755) != 0) {
-                g_set_error(error,
-                            DNF_ERROR,
-                            DNF_ERROR_INTERNAL_ERROR,
-                            "Failed to create %s",
-                            directory_slash);
-                goto out;
-            }
-        }
-    } else {
-        /* librepo uses the GNU basename() function to find out if the
-         * output directory is fully specified as a filename, but
-         * basename needs a trailing '/' to detect it's not a filename */
-        directory_slash = g_build_filename(directory, "/", NULL);
-    }
 
     global_data.download_size = dnf_package_array_get_download_size(packages);
     for (i = 0; i < packages->len; i++) {
         auto pkg = static_cast<DnfPackage *>(packages->pdata[i]);
-        PackageDownloadData *data;
         LrPackageTarget *target;
-        const unsigned char *checksum;
-        int checksum_type;
-        g_autofree char *checksum_str = NULL;
 
-        g_debug("downloading %s to %s",
-                dnf_package_get_location(pkg),
-                directory_slash);
+        target = dnf_repo_new_package_target(repo, pkg, directory_slash, state, &global_data, error);
+        if (target == NULL)
+            goto out;
 
-        data = g_slice_new0(PackageDownloadData);
-        data->pkg = pkg;
-        data->state = state;
-        data->global_download_data = &global_data;
+        package_targets = g_slist_prepend(package_targets, target);
+    }
 
-        checksum = dnf_package_get_chksum(pkg, &checksum_type);
-        checksum_str = hy_chksum_str(checksum, checksum_type);
+    g_debug("Downloading %u packages from %s, %ld at once and %ld per mirror",
+            packages->len, dnf_repo_get_id(repo),
+            priv->max_parallel_downloads, priv->max_downloads_per_mirror);
+    ret = dnf_repo_run_package_targets(package_targets, &global_data, error);
+out:
+    dnf_repo_reset_progress_cb(repo);
+    dnf_repo_restore_download_limits(repo, prev_max_parallel, prev_max_per_mirror);
+    g_free(global_data.last_mirror_failure_message);
+    g_free(global_data.last_mirror_url);
+    g_slist_free_full(package_targets, (GDestroyNotify)lr_packagetarget_free);
+    return ret;
+} CATCH_TO_GERROR(FALSE)
+
+/**
+ * dnf_repo_download_packages_from_repos:
+ * @packages: (element-type DnfPackage): an array of packages from any repos
+ * @directory: the destination directory, or %NULL for the package cache of each repo.
+ * @state: a #DnfState.
+ * @error: a #GError or %NULL.
+ *
+ * Downloads packages of several repos in a single librepo transfer,
+ * reporting the progress of all of them through @state. The largest
+ * packages are started first so that they do not finish last on their own.
+ * The transfer runs at most max_parallel_downloads downloads at once and
+ * max_downloads_per_mirror per mirror, as set in the main configuration;
+ * the previous limits of every participating handle are restored afterwards.
+ *
+ * Returns: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.74.0
+ **/
+gboolean
+dnf_repo_download_packages_from_repos(GPtrArray *packages,
+                                      const gchar *directory,
+                                      DnfState *state,
+                                      GError **error) try
+{
+    gboolean ret = FALSE;
+    guint i;
+    GSList *package_targets = NULL;
+    GlobalDownloadData global_data = { 0, };
+    g_autoptr(GHashTable) repo_directories = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    auto & mainConf = libdnf::getGlobalMainConfig();
+    long max_parallel = mainConf.max_parallel_downloads().getValue();
+    long max_per_mirror = mainConf.max_downloads_per_mirror().getValue();
+    struct PreviousLimits {
+        DnfRepo *repo;
+        long max_parallel_downloads;
+        long max_downloads_per_mirror;
+    };
+    std::vector<PreviousLimits> previous_limits;
+
+    std::vector<DnfPackage *> sorted;
+    sorted.reserve(packages->len);
+    for (i = 0; i < packages->len; i++)
+        sorted.push_back(static_cast<DnfPackage *>(packages->pdata[i]));
+    std::stable_sort(sorted.begin(), sorted.end(), [](DnfPackage *first, DnfPackage *second) {
+        return dnf_package_get_downloadsize(first) > dnf_package_get_downloadsize(second);
+    });
+
+    global_data.download_size = dnf_package_array_get_download_size(packages);
+    /* prepend from the smallest so that the list starts with the largest */
+    for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
+        DnfPackage *pkg = *it;
+        DnfRepo *repo = dnf_package_get_repo(pkg);
+        LrPackageTarget *target;
 
-        std::string encodedUrl = dnf_package_get_location(pkg);
-        if (encodedUrl.find("://") == std::string::npos) {
-            encodedUrl = libdnf::urlEncode(encodedUrl, "/");
+        if (repo == NULL) {
+            g_set_error_literal(error,
+                                DNF_ERROR,
+                                DNF_ERROR_INTERNAL_ERROR,
+                                "package repo is unset");
+            goto out;
+        }
+        auto directory_slash = static_cast<const gchar *>(g_hash_table_lookup(repo_directories, repo));
+        if (directory_slash == NULL) {
+            gchar *repo_directory = dnf_repo_get_download_directory(repo, directory, error);
+            if (repo_directory == NULL)
+                goto out;
+            g_hash_table_insert(repo_directories, repo, repo_directory);
+            directory_slash = repo_directory;
+
+            /* librepo takes the limits from the handle of one of the targets,
+             * so give every handle the same ones */
+            auto priv = GET_PRIVATE(repo);
+            previous_limits.push_back({repo, priv->max_parallel_downloads,
+                                       priv->max_downloads_per_mirror});
+            if (!dnf_repo_set_download_limits(repo, max_parallel, max_per_mirror, error))
+                goto out;
         }
 
-        target = lr_packagetarget_new_v2(priv->repo_handle,
-                                         encodedUrl.c_str(),
-                                         directory_slash,
-                                         dnf_repo_checksum_hy_to_lr(checksum_type),
-                                         checksum_str,
-                                         dnf_package_get_downloadsize(pkg),
-                                         dnf_package_get_baseurl(pkg),
-                                         TRUE,
-                                         package_download_update_state_cb,
-                                         data,
-                                         package_download_end_cb,
-                                         mirrorlist_failure_cb,
-                                         error);
+        target = dnf_repo_new_package_target(repo, pkg, directory_slash, state, &global_data, error);
         if (target == NULL)
             goto out;
 
         package_targets = g_slist_prepend(package_targets, target);
     }
 
-    ret = lr_download_packages(package_targets, LR_PACKAGEDOWNLOAD_FAILFAST, &error_local);
-    if (!ret) {
-        if (g_error_matches(error_local,
-                            LR_PACKAGE_DOWNLOADER_ERROR,
-                            LRE_ALREADYDOWNLOADED)) {
-            /* ignore */
-            g_clear_error(&error_local);
-        } else {
-            if (global_data.last_mirror_failure_message) {
-                g_autofree gchar *orig_message = error_local->message;
-                error_local->message = g_strconcat(orig_message, "; Last error: ", global_data.last_mirror_failure_message, NULL);
-            }
-            g_propagate_error(error, error_local);
-            error_local = NULL;
-            goto out;
-        }
-    }
-
-    ret = TRUE;
+    g_debug("Downloading %u packages from %u repos, %ld at once and %ld per mirror",
+            packages->len, g_hash_table_size(repo_directories), max_parallel, max_per_mirror);
+    ret = dnf_repo_run_package_targets(package_targets, &global_data, error);
 out:
-    if (!lr_handle_setopt(priv->repo_handle, NULL, LRO_PROGRESSCB, NULL))
-            g_debug("Failed to reset LRO_PROGRESSCB to NULL");
-    if (!lr_handle_setopt(priv->repo_handle, NULL, LRO_PROGRESSDATA, 0xdeadbeef))
-            g_debug("Failed to set LRO_PROGRESSDATA to 0xdeadbeef");
+    for (auto & previous : previous_limits) {
+        dnf_repo_reset_progress_cb(previous.repo);
+        dnf_repo_restore_download_limits(previous.repo, previous.max_parallel_downloads,
+                                         previous.max_downloads_per_mirror);
+    }
     g_free(global_data.last_mirror_failure_message);
     g_free(global_data.last_mirror_url);
     g_slist_free_full(package_targets, (GDestroyNotify)lr_packagetarget_free);
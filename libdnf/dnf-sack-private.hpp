@@ -21,14 +21,20 @@
 #ifndef HY_SACK_INTERNAL_H
 #define HY_SACK_INTERNAL_H
 
+#include <functional>
 #include <stdio.h>
 #include <solv/pool.h>
 #include <vector>
 
 #include "dnf-sack.h"
 #include "hy-query.h"
+#include "sack/advisoryindex.hpp"
+#include "sack/fileindex.hpp"
+#include "sack/latestindex.hpp"
+#include "sack/nameindex.hpp"
 #include "sack/packageset.hpp"
 #include "sack/query.hpp"
+#include "sack/updowngraph.hpp"
 #include "module/ModulePackage.hpp"
 #include "module/ModulePackageContainer.hpp"
 
@@ -63,6 +69,14 @@ libdnf::ModulePackageContainer * dnf_sack_set_module_container(
     DnfSack *sack, libdnf::ModulePackageContainer * newConteiner);
 libdnf::ModulePackageContainer * dnf_sack_get_module_container(DnfSack *sack);
 void         dnf_sack_make_provides_ready   (DnfSack    *sack);
+libdnf::FileIndex *dnf_sack_get_file_index  (DnfSack    *sack);
+libdnf::NameIndex *dnf_sack_get_name_index  (DnfSack    *sack);
+libdnf::UpdownGraph *dnf_sack_get_updown_graph(DnfSack  *sack);
+libdnf::LatestIndex *dnf_sack_get_latest_index(DnfSack  *sack);
+libdnf::AdvisoryIndex *dnf_sack_get_advisory_index(DnfSack *sack);
+gboolean     dnf_sack_refill_system_repo    (DnfSack    *sack,
+                                             const std::function<bool(Repo *repo, Repo *ref)> & fill,
+                                             GError    **error);
 Id           dnf_sack_running_kernel        (DnfSack    *sack);
 void         dnf_sack_recompute_considered_map  (DnfSack * sack, Map ** considered, libdnf::Query::ExcludeFlags flags);
 void         dnf_sack_recompute_considered  (DnfSack    *sack);
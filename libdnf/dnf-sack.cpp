@@ -34,12 +34,17 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
 #include <errno.h>
+#include <fcntl.h>
 #include <functional>
 #include <unistd.h>
 #include <iostream>
 #include <list>
+#include <mutex>
 #include <set>
+#include <thread>
 
 extern "C" {
 #include <solv/evr.h>
@@ -80,6 +85,8 @@ extern "C" {
 #include "module/ModulePackage.hpp"
 #include "repo/Repo-private.hpp"
 #include "repo/solvable/DependencyContainer.hpp"
+#include "sack/fileindex.hpp"
+#include "sack/nameindex.hpp"
 #include "utils/File.hpp"
 #include "utils/utils.hpp"
 #include "log.hpp"
@@ -88,6 +95,8 @@ extern "C" {
 
 #define DEFAULT_CACHE_ROOT "/var/cache/hawkey"
 #define DEFAULT_CACHE_USER "/var/tmp/hawkey"
+/* building the file index costs about as much as eight filelist scans */
+#define FILE_INDEX_MIN_LOOKUPS 8
 
 typedef struct
 {
@@ -103,6 +112,7 @@ typedef struct
     Queue                installonly;
     Repo                *cmdline_repo;
     gboolean             considered_uptodate;
+    gboolean             system_excludes;   /* main includepkgs/excludepkgs cover @System */
     gboolean             have_set_arch;
     gboolean             all_arch;
     gboolean             provides_ready;
@@ -112,6 +122,12 @@ typedef struct
     dnf_sack_running_kernel_fn_t  running_kernel_fn;
     guint                installonly_limit;
     libdnf::ModulePackageContainer * moduleContainer;
+    libdnf::FileIndex   *file_index;        /* built once file queries keep coming */
+    guint                file_lookups;      /* file queries since the filelists changed */
+    libdnf::NameIndex   *name_index;        /* built on first indexed name lookup */
+    libdnf::UpdownGraph *updown_graph;      /* built on first up/downgrade filter */
+    libdnf::LatestIndex *latest_index;      /* built on first latest filter */
+    libdnf::AdvisoryIndex *advisory_index;  /* built on first advisory lookup */
 } DnfSackPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE(DnfSack, dnf_sack, G_TYPE_OBJECT)
@@ -147,6 +163,11 @@ dnf_sack_finalize(GObject *object)
     free_map_fully(priv->module_includes);
     free_map_fully(pool->considered);
     free_map_fully(priv->pkg_solvables);
+    delete priv->file_index;
+    delete priv->name_index;
+    delete priv->updown_graph;
+    delete priv->latest_index;
+    delete priv->advisory_index;
     pool_free(priv->pool);
     if (priv->moduleContainer) {
         delete priv->moduleContainer;
@@ -225,6 +246,9 @@ dnf_sack_new(void)
     return DNF_SACK(g_object_new(DNF_TYPE_SACK, NULL));
 }
 
+/* stdio buffer used when reading solv files, they are read front to back */
+#define SOLV_READ_BUFSIZE (128 * 1024)
+
 // Try to load cached solv file into repo otherwise return FALSE
 static gboolean
 try_to_use_cached_solvfile(const char *path, Repo *repo, int flags, const unsigned char *checksum, GError **err){
@@ -240,6 +264,14 @@ try_to_use_cached_solvfile(const char *path, Repo *repo, int flags, const unsign
         }
         return FALSE;
     }
+    // Read the file through a large buffer and let the kernel read ahead. The file is not
+    // mmap()ed: libsolv copies the data anyway and needs a real descriptor to page in the
+    // vertical data (e.g. filelists) lazily.
+    // glibc ignores the size unless it is given the buffer too, the buffer is freed after the
+    // fclose() below
+    std::unique_ptr<char[]> read_buffer(new char[SOLV_READ_BUFSIZE]);
+    setvbuf(fp_cache, read_buffer.get(), _IOFBF, SOLV_READ_BUFSIZE);
+    posix_fadvise(fileno(fp_cache), 0, 0, POSIX_FADV_SEQUENTIAL);
     std::unique_ptr<SolvUserdata, decltype(solv_free)*> solv_userdata = solv_userdata_read(fp_cache);
     gboolean ret = TRUE;
     if (solv_userdata && solv_userdata_verify(solv_userdata.get(), checksum)) {
@@ -252,6 +284,8 @@ try_to_use_cached_solvfile(const char *path, Repo *repo, int flags, const unsign
                          _("repo_add_solv() has failed."));
             ret = FALSE;
         }
+        // the paged data is read at random later on through a dup() of the descriptor
+        posix_fadvise(fileno(fp_cache), 0, 0, POSIX_FADV_NORMAL);
     } else {
         ret = FALSE;
     }
@@ -383,6 +417,30 @@ dnf_sack_recompute_considered(DnfSack *sack)
     priv->considered_uptodate = TRUE;
 }
 
+/* the file index describes the pool's filelists, drop it whenever they change */
+static void
+dnf_sack_invalidate_file_index(DnfSackPrivate *priv)
+{
+    delete priv->file_index;
+    priv->file_index = NULL;
+    priv->file_lookups = 0;
+}
+
+/* drop all lookup indexes, the packages in the pool have changed */
+static void
+dnf_sack_invalidate_indexes(DnfSackPrivate *priv)
+{
+    dnf_sack_invalidate_file_index(priv);
+    delete priv->name_index;
+    priv->name_index = NULL;
+    delete priv->updown_graph;
+    priv->updown_graph = NULL;
+    delete priv->latest_index;
+    priv->latest_index = NULL;
+    delete priv->advisory_index;
+    priv->advisory_index = NULL;
+}
+
 static gboolean
 load_ext(DnfSack *sack, HyRepo hrepo, _hy_repo_repodata which_repodata,
          const char *suffix, const char * which_filename,
@@ -399,6 +457,13 @@ load_ext(DnfSack *sack, HyRepo hrepo, _hy_repo_repodata which_repodata,
     char *fn_cache =  dnf_sack_give_cache_fn(sack, name, suffix);
     assert(libdnf::repoGetImpl(hrepo)->checksum);
 
+    if (which_repodata == _HY_REPODATA_FILENAMES)
+        dnf_sack_invalidate_file_index(priv);
+    if (which_repodata == _HY_REPODATA_UPDATEINFO) {
+        delete priv->advisory_index;
+        priv->advisory_index = NULL;
+    }
+
     int flags = 0;
     /* the updateinfo is not a real extension */
     if (which_repodata != _HY_REPODATA_UPDATEINFO)
@@ -821,6 +886,7 @@ out:
     if (retval) {
         libdnf::repoGetImpl(hrepo)->attachLibsolvRepo(repo);
         priv->provides_ready = 0;
+        dnf_sack_invalidate_indexes(priv);
     } else
         repo_free(repo, 1);
     return retval;
@@ -1262,6 +1328,7 @@ dnf_sack_add_cmdline_package_flags(DnfSack *sack, const char *fn, const int flag
     Repo *repo = dnf_sack_setup_cmdline_repo(sack);
     Id p;
     priv->provides_ready = 0;    /* triggers internalizing later */
+    dnf_sack_invalidate_indexes(priv);
     p = repo_add_rpm(repo, fn, flags);
     if (p == 0) {
         g_warning ("failed to read RPM: %s, skipping",
@@ -1685,6 +1752,7 @@ dnf_sack_set_provides_not_ready(DnfSack *sack)
 {
     DnfSackPrivate *priv = GET_PRIVATE(sack);
     priv->provides_ready = FALSE;
+    dnf_sack_invalidate_indexes(priv);
 }
 
 /**
@@ -1774,7 +1842,9 @@ dnf_sack_repo_enabled(DnfSack *sack, const char *reponame, int enabled)
  * @flags: what to load into the sack, e.g. %DNF_SACK_LOAD_FLAG_USE_FILELISTS.
  * @error: a #GError or %NULL.
  *
- * Loads the rpmdb into the sack.
+ * Loads the rpmdb into the sack. With %DNF_SACK_LOAD_FLAG_BUILD_CACHE the
+ * result is cached in @System.solv and reused while the rpmdb cookie stays
+ * the same.
  *
  * Returns: %TRUE for success
  *
@@ -1797,28 +1867,64 @@ dnf_sack_load_system_repo(DnfSack *sack, HyRepo a_hrepo, int flags, GError **err
         hrepo = hy_repo_create(HY_SYSTEM_REPO_NAME);
     auto repoImpl = libdnf::repoGetImpl(hrepo);
 
-    repoImpl->load_flags = flags &= ~DNF_SACK_LOAD_FLAG_BUILD_CACHE;
+    /* the rpmdb cookie takes the role of the repomd checksum for the cache */
+    gboolean have_checksum = priv->cache_dir &&
+        !checksum_rpmdb(repoImpl->checksum, pool_get_rootdir(pool));
+    if (!have_checksum)
+        flags &= ~DNF_SACK_LOAD_FLAG_BUILD_CACHE;
+    const int build_cache = flags & DNF_SACK_LOAD_FLAG_BUILD_CACHE;
+    repoImpl->load_flags = flags;
+    char *fn_cache = dnf_sack_give_cache_fn(sack, HY_SYSTEM_REPO_NAME, NULL);
 
     repo = repo_create(pool, HY_SYSTEM_REPO_NAME);
 
-    g_debug("fetching rpmdb");
-    int flagsrpm = REPO_REUSE_REPODATA | RPM_ADD_WITH_HDRID | REPO_USE_ROOTDIR;
-    int rc = repo_add_rpmdb_reffp(repo, NULL, flagsrpm);
-    if (!rc) {
-        repoImpl->state_main = _HY_LOADED_FETCH;
+    if (have_checksum &&
+        try_to_use_cached_solvfile(fn_cache, repo, 0, repoImpl->checksum, error)) {
+        g_debug("using cached %s (0x%s)", HY_SYSTEM_REPO_NAME,
+                pool_checksum_str(pool, repoImpl->checksum));
+        repoImpl->state_main = _HY_LOADED_CACHE;
     } else {
-        repo_free(repo, 1);
-        ret = FALSE;
-        g_set_error (error,
-                     DNF_ERROR,
-                     DNF_ERROR_FILE_INVALID,
-                     _("failed loading RPMDB"));
-        goto finish;
+        /* a broken cache is not fatal, the rpmdb is the source of truth */
+        if (error && *error) {
+            g_warning("Failed to use %s: %s", fn_cache, (*error)->message);
+            g_clear_error(error);
+            repo_empty(repo, 1);
+        }
+
+        g_debug("fetching rpmdb");
+        /* reuse unchanged headers from the stale cache, if there is any */
+        FILE *fp_cache = priv->cache_dir ? fopen(fn_cache, "r") : NULL;
+        int flagsrpm = REPO_REUSE_REPODATA | RPM_ADD_WITH_HDRID | REPO_USE_ROOTDIR;
+        int rc = repo_add_rpmdb_reffp(repo, fp_cache, flagsrpm);
+        if (fp_cache)
+            fclose(fp_cache);
+        if (rc) {
+            repo_free(repo, 1);
+            g_free(fn_cache);
+            ret = FALSE;
+            g_set_error (error,
+                         DNF_ERROR,
+                         DNF_ERROR_FILE_INVALID,
+                         _("failed loading RPMDB"));
+            goto finish;
+        }
+        repoImpl->state_main = _HY_LOADED_FETCH;
     }
+    g_free(fn_cache);
 
     libdnf::repoGetImpl(hrepo)->attachLibsolvRepo(repo);
     pool_set_installed(pool, repo);
     priv->provides_ready = 0;
+    dnf_sack_invalidate_indexes(priv);
+
+    if (repoImpl->state_main == _HY_LOADED_FETCH && build_cache) {
+        GError *error_local = NULL;
+        /* failing to write the cache only costs the next run a full rpmdb read */
+        if (!write_main(sack, hrepo, 1, &error_local)) {
+            g_warning("Failed to write %s cache: %s", HY_SYSTEM_REPO_NAME, error_local->message);
+            g_error_free(error_local);
+        }
+    }
 
     repoImpl->main_nsolvables = repo->nsolvables;
     repoImpl->main_nrepodata = repo->nrepodata;
@@ -1831,6 +1937,182 @@ dnf_sack_load_system_repo(DnfSack *sack, HyRepo a_hrepo, int flags, GError **err
     return ret;
 } CATCH_TO_GERROR(FALSE)
 
+static void process_system_excludes(DnfSack *sack);
+
+/* clear what the exclude and include maps know about the packages of repo */
+static void
+dnf_sack_forget_repo_excludes(DnfSackPrivate *priv, Repo *repo)
+{
+    Map *maps[] = {priv->pkg_excludes, priv->pkg_includes, priv->repo_excludes,
+                   priv->module_excludes};
+    for (auto map : maps) {
+        if (map == NULL)
+            continue;
+        Id p;
+        Solvable *s;
+        FOR_REPO_SOLVABLES(repo, p, s) {
+            if (p < map->size << 3)
+                MAPCLR(map, p);
+        }
+    }
+}
+
+/*
+ * Move the packages of repo to the end of the pool after old_repo and repo
+ * were freed, so they take over the ids of old_repo. libsolv only reuses ids
+ * at the end of the pool, without this every reload would grow the pool by
+ * the number of installed packages. Returns the repo holding the packages.
+ */
+static Repo *
+dnf_sack_reuse_system_repo_ids(Pool *pool, Repo *repo, Repo *old_repo)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL || repo_write(repo, fp) != 0 || fflush(fp) != 0) {
+        g_debug("cannot move %s packages, their ids are not reused", HY_SYSTEM_REPO_NAME);
+        if (fp)
+            fclose(fp);
+        repo_free(old_repo, 1);
+        return repo;
+    }
+
+    repo_free(repo, 1);
+    repo_free(old_repo, 1);
+    repo = repo_create(pool, HY_SYSTEM_REPO_NAME);
+    rewind(fp);
+    if (repo_add_solv(repo, fp, 0) != 0) {
+        g_warning("Failed to move %s packages: %s", HY_SYSTEM_REPO_NAME, pool_errstr(pool));
+        repo_empty(repo, 1);
+    }
+    fclose(fp);
+    return repo;
+}
+
+/**
+ * dnf_sack_refill_system_repo: (skip)
+ * @sack: a #DnfSack instance.
+ * @fill: fills the new system repo, gets the current one for reference.
+ * @error: a #GError or %NULL.
+ *
+ * Replaces the packages of the system repo with the ones @fill adds. The
+ * new packages reuse the ids of the old ones once the system repo is at
+ * the end of the pool, which it is after the first refill.
+ *
+ * Returns: %TRUE for success
+ */
+gboolean
+dnf_sack_refill_system_repo(DnfSack *sack,
+                            const std::function<bool(Repo *repo, Repo *ref)> & fill,
+                            GError **error)
+{
+    DnfSackPrivate *priv = GET_PRIVATE(sack);
+    Pool *pool = dnf_sack_get_pool(sack);
+    Repo *old_repo = pool->installed;
+    if (old_repo == NULL || old_repo->appdata == NULL) {
+        g_set_error_literal(error, DNF_ERROR, DNF_ERROR_INTERNAL_ERROR,
+                            _("no system repo to refill"));
+        return FALSE;
+    }
+    auto hrepo = static_cast<HyRepo>(old_repo->appdata);
+    bool old_repo_at_end = old_repo->end == pool->nsolvables;
+
+    Repo *repo = repo_create(pool, HY_SYSTEM_REPO_NAME);
+    if (!fill(repo, old_repo)) {
+        repo_free(repo, 1);
+        g_set_error (error,
+                     DNF_ERROR,
+                     DNF_ERROR_FILE_INVALID,
+                     _("failed loading RPMDB"));
+        return FALSE;
+    }
+
+    dnf_sack_forget_repo_excludes(priv, old_repo);
+    if (old_repo_at_end)
+        repo = dnf_sack_reuse_system_repo_ids(pool, repo, old_repo);
+    else
+        repo_free(old_repo, 1);
+    libdnf::repoGetImpl(hrepo)->attachLibsolvRepo(repo);
+    pool_set_installed(pool, repo);
+    /* the ids may have been used by other packages before */
+    dnf_sack_forget_repo_excludes(priv, repo);
+    if (priv->system_excludes)
+        process_system_excludes(sack);
+
+    priv->provides_ready = 0;
+    priv->running_kernel_id = -1;
+    priv->pool_nsolvables = 0;
+    dnf_sack_invalidate_indexes(priv);
+    priv->considered_uptodate = FALSE;
+    return TRUE;
+}
+
+/**
+ * dnf_sack_reload_system_repo:
+ * @sack: a #DnfSack instance.
+ * @error: a #GError or %NULL.
+ *
+ * Brings the installed packages in line with the rpmdb without touching
+ * the available repos. Unchanged headers are reused from the current
+ * system repo, only the added ones are read from the rpmdb. Nothing is
+ * done while the rpmdb cookie is the one the system repo was loaded
+ * with, and the system repo is loaded when there is none yet.
+ *
+ * Installed packages get new ids, so any #DnfPackage, #DnfPackageSet,
+ * query or goal made before refers to stale solvables and must be
+ * recreated. Excludes and includes set from package sets lose their
+ * installed packages; the includepkgs and excludepkgs of the main
+ * configuration are applied again to the new installed packages when
+ * dnf_sack_add_repos() applied them before.
+ *
+ * Returns: %TRUE for success
+ *
+ * Since: 0.74.0
+ */
+gboolean
+dnf_sack_reload_system_repo(DnfSack *sack, GError **error) try
+{
+    DnfSackPrivate *priv = GET_PRIVATE(sack);
+    Pool *pool = dnf_sack_get_pool(sack);
+    Repo *old_repo = pool->installed;
+
+    if (old_repo == NULL || old_repo->appdata == NULL)
+        return dnf_sack_load_system_repo(sack, NULL, DNF_SACK_LOAD_FLAG_BUILD_CACHE, error);
+
+    auto hrepo = static_cast<HyRepo>(old_repo->appdata);
+    auto repoImpl = libdnf::repoGetImpl(hrepo);
+
+    unsigned char checksum[CHKSUM_BYTES];
+    gboolean have_checksum = !checksum_rpmdb(checksum, pool_get_rootdir(pool));
+    if (have_checksum && memcmp(checksum, repoImpl->checksum, CHKSUM_BYTES) == 0)
+        return TRUE;
+
+    g_debug("refreshing %s", HY_SYSTEM_REPO_NAME);
+    auto add_rpmdb = [](Repo *repo, Repo *ref) {
+        int flagsrpm = REPO_REUSE_REPODATA | RPM_ADD_WITH_HDRID | REPO_USE_ROOTDIR;
+        return repo_add_rpmdb(repo, ref, flagsrpm) == 0;
+    };
+    if (!dnf_sack_refill_system_repo(sack, add_rpmdb, error))
+        return FALSE;
+
+    Repo *repo = pool->installed;
+    repoImpl->state_main = _HY_LOADED_FETCH;
+    if (have_checksum)
+        memcpy(repoImpl->checksum, checksum, CHKSUM_BYTES);
+
+    if (have_checksum && priv->cache_dir &&
+        (repoImpl->load_flags & DNF_SACK_LOAD_FLAG_BUILD_CACHE)) {
+        GError *error_local = NULL;
+        if (!write_main(sack, hrepo, 1, &error_local)) {
+            g_warning("Failed to write %s cache: %s", HY_SYSTEM_REPO_NAME, error_local->message);
+            g_error_free(error_local);
+        }
+    }
+
+    repoImpl->main_nsolvables = repo->nsolvables;
+    repoImpl->main_nrepodata = repo->nrepodata;
+    repoImpl->main_end = repo->end;
+    return TRUE;
+} CATCH_TO_GERROR(FALSE)
+
 /**
  * dnf_sack_load_repo:
  * @sack: a #DnfSack instance.
@@ -2067,6 +2349,126 @@ dnf_sack_make_provides_ready(DnfSack *sack)
     priv->provides_ready = 1;
 }
 
+/**
+ * dnf_sack_get_file_index: (skip)
+ * @sack: a #DnfSack instance.
+ *
+ * Returns the path to solvable index over the filelists of the pool.
+ * The index is only built once FILE_INDEX_MIN_LOOKUPS file queries were
+ * asked for it since the filelists last changed, a few one-shot queries
+ * are answered cheaper by scanning the filelists.
+ *
+ * Returns: a #libdnf::FileIndex owned by the sack, or %NULL while the
+ * filelists should still be scanned.
+ **/
+libdnf::FileIndex *
+dnf_sack_get_file_index(DnfSack *sack)
+{
+    DnfSackPrivate *priv = GET_PRIVATE(sack);
+
+    if (priv->file_index && !priv->file_index->isCurrent(priv->pool))
+        dnf_sack_invalidate_file_index(priv);
+    if (!priv->file_index) {
+        if (++priv->file_lookups < FILE_INDEX_MIN_LOOKUPS)
+            return NULL;
+        priv->file_index = new libdnf::FileIndex(priv->pool);
+    }
+    return priv->file_index;
+}
+
+/**
+ * dnf_sack_get_name_index: (skip)
+ * @sack: a #DnfSack instance.
+ *
+ * Returns the name to solvable index over the packages of the pool,
+ * building it on first use.
+ *
+ * Returns: a #libdnf::NameIndex owned by the sack.
+ **/
+libdnf::NameIndex *
+dnf_sack_get_name_index(DnfSack *sack)
+{
+    DnfSackPrivate *priv = GET_PRIVATE(sack);
+
+    if (priv->name_index && !priv->name_index->isCurrent(priv->pool)) {
+        delete priv->name_index;
+        priv->name_index = NULL;
+    }
+    if (!priv->name_index)
+        priv->name_index = new libdnf::NameIndex(priv->pool);
+    return priv->name_index;
+}
+
+/**
+ * dnf_sack_get_updown_graph: (skip)
+ * @sack: a #DnfSack instance.
+ *
+ * Returns the graph of available packages that upgrade or downgrade
+ * installed ones, building it on first use. The caller must have made
+ * the provides ready and the sack must have an installed repo.
+ *
+ * Returns: a #libdnf::UpdownGraph owned by the sack.
+ **/
+libdnf::UpdownGraph *
+dnf_sack_get_updown_graph(DnfSack *sack)
+{
+    DnfSackPrivate *priv = GET_PRIVATE(sack);
+
+    if (priv->updown_graph && !priv->updown_graph->isCurrent(priv->pool)) {
+        delete priv->updown_graph;
+        priv->updown_graph = NULL;
+    }
+    if (!priv->updown_graph)
+        priv->updown_graph = new libdnf::UpdownGraph(priv->pool);
+    return priv->updown_graph;
+}
+
+/**
+ * dnf_sack_get_latest_index: (skip)
+ * @sack: a #DnfSack instance.
+ *
+ * Returns the packages of the pool presorted by name, arch and EVR,
+ * building each ordering on first use.
+ *
+ * Returns: a #libdnf::LatestIndex owned by the sack.
+ **/
+libdnf::LatestIndex *
+dnf_sack_get_latest_index(DnfSack *sack)
+{
+    DnfSackPrivate *priv = GET_PRIVATE(sack);
+
+    if (priv->latest_index && !priv->latest_index->isCurrent(priv->pool)) {
+        delete priv->latest_index;
+        priv->latest_index = NULL;
+    }
+    if (!priv->latest_index)
+        priv->latest_index = new libdnf::LatestIndex(priv->pool);
+    return priv->latest_index;
+}
+
+/**
+ * dnf_sack_get_advisory_index: (skip)
+ * @sack: a #DnfSack instance.
+ *
+ * Returns the index over the advisories of the pool and the packages
+ * they list, building it on first use.
+ *
+ * Returns: a #libdnf::AdvisoryIndex owned by the sack.
+ **/
+libdnf::AdvisoryIndex *
+dnf_sack_get_advisory_index(DnfSack *sack)
+{
+    DnfSackPrivate *priv = GET_PRIVATE(sack);
+
+    if (priv->advisory_index && !priv->advisory_index->isCurrent(priv->pool)) {
+        delete priv->advisory_index;
+        priv->advisory_index = NULL;
+    }
+    if (!priv->advisory_index)
+        priv->advisory_index = new libdnf::AdvisoryIndex(sack);
+    return priv->advisory_index;
+}
+
 /**
  * dnf_sack_running_kernel: (skip)
  * @sack: a #DnfSack instance.
@@ -2143,6 +2545,39 @@ dnf_sack_get_module_container(DnfSack *sack)
 
 /**********************************************************************/
 
+// Match all includepkgs/excludepkgs patterns of one config in a single pass over the query
+static std::vector<libdnf::PackageSet>
+filter_excludes_subjects(libdnf::Query & query, const std::vector<std::string> & patterns)
+{
+    if (patterns.empty())
+        return {};
+    return query.filterSubjects(patterns, false, true, false, false);
+}
+
+// Add the matches of the main includepkgs/excludepkgs in query, returns whether includes matched
+static bool
+process_main_excludes(DnfSack *sack, libdnf::Query & query, libdnf::PackageSet & includes,
+                      libdnf::PackageSet & excludes)
+{
+    auto & mainConf = libdnf::getGlobalMainConfig();
+    bool useGlobalIncludes = false;
+
+    for (auto & matched : filter_excludes_subjects(query, mainConf.includepkgs().getValue())) {
+        if (matched.empty())
+            continue;
+        includes += matched;
+        useGlobalIncludes = true;
+    }
+    for (const auto & matched : filter_excludes_subjects(query, mainConf.excludepkgs().getValue())) {
+        excludes += matched;
+    }
+
+    if (useGlobalIncludes) {
+        dnf_sack_set_use_includes(sack, nullptr, true);
+    }
+    return useGlobalIncludes;
+}
+
 static void
 process_excludes(DnfSack *sack, GPtrArray *enabled_repos)
 {
@@ -2168,48 +2603,24 @@ process_excludes(DnfSack *sack, GPtrArray *enabled_repos)
         repoQuery.addFilter(HY_PKG_REPONAME, HY_EQ, repo->getId().c_str());
         repoQuery.apply();
 
-        for (const auto & name : repo->getConfig()->includepkgs().getValue()) {
-            libdnf::Query query(repoQuery);
-            auto ret = query.filterSubject(name.c_str(), nullptr, false, true, false, false);
-            if (ret.first) {
-                repoIncludes += *query.runSet();
-                includesExist = true;
-                repo->setUseIncludes(true);
-            }
+        auto & repoConf = *repo->getConfig();
+        for (auto & matched : filter_excludes_subjects(repoQuery, repoConf.includepkgs().getValue())) {
+            if (matched.empty())
+                continue;
+            repoIncludes += matched;
+            includesExist = true;
+            repo->setUseIncludes(true);
         }
-
-        for (const auto & name : repo->getConfig()->excludepkgs().getValue()) {
-            libdnf::Query query(repoQuery);
-            auto ret = query.filterSubject(name.c_str(), nullptr, false, true, false, false);
-            if (ret.first) {
-                repoExcludes += *query.runSet();
-            }
+        for (const auto & matched : filter_excludes_subjects(repoQuery, repoConf.excludepkgs().getValue())) {
+            repoExcludes += matched;
         }
     }
 
     if (std::find(disabled.begin(), disabled.end(), "main") == disabled.end()) {
-        bool useGlobalIncludes = false;
-        for (const auto & name : mainConf.includepkgs().getValue()) {
-            libdnf::Query query(sack);
-            auto ret = query.filterSubject(name.c_str(), nullptr, false, true, false, false);
-            if (ret.first) {
-                repoIncludes += *query.runSet();
-                includesExist = true;
-                useGlobalIncludes = true;
-            }
-        }
-
-        for (const auto & name : mainConf.excludepkgs().getValue()) {
-            libdnf::Query query(sack);
-            auto ret = query.filterSubject(name.c_str(), nullptr, false, true, false, false);
-            if (ret.first) {
-                repoExcludes += *query.runSet();
-            }
-        }
-        
-        if (useGlobalIncludes) {
-            dnf_sack_set_use_includes(sack, nullptr, true);
-        }
+        libdnf::Query query(sack);
+        if (process_main_excludes(sack, query, repoIncludes, repoExcludes))
+            includesExist = true;
+        GET_PRIVATE(sack)->system_excludes = TRUE;
     }
 
     if (includesExist) {
@@ -2218,46 +2629,53 @@ process_excludes(DnfSack *sack, GPtrArray *enabled_repos)
     dnf_sack_add_excludes(sack, &repoExcludes);
 }
 
-/**
- * dnf_sack_add_repo:
- */
-gboolean
-dnf_sack_add_repo(DnfSack *sack,
-                    DnfRepo *repo,
+/* apply the main includepkgs/excludepkgs again to reloaded installed packages */
+static void
+process_system_excludes(DnfSack *sack)
+{
+    libdnf::Query query(sack, libdnf::Query::ExcludeFlags::IGNORE_EXCLUDES);
+    query.installed();
+    libdnf::PackageSet includes(sack);
+    libdnf::PackageSet excludes(sack);
+
+    if (process_main_excludes(sack, query, includes, excludes))
+        dnf_sack_add_includes(sack, &includes);
+    dnf_sack_add_excludes(sack, &excludes);
+}
+
+static int
+dnf_sack_add_flags_to_load_flags(DnfSackAddFlags flags)
+{
+    int flags_hy = DNF_SACK_LOAD_FLAG_BUILD_CACHE;
+
+    /* only load what's required */
+    if ((flags & DNF_SACK_ADD_FLAG_FILELISTS) > 0)
+        flags_hy |= DNF_SACK_LOAD_FLAG_USE_FILELISTS;
+    if ((flags & DNF_SACK_ADD_FLAG_OTHER) > 0)
+        flags_hy |= DNF_SACK_LOAD_FLAG_USE_OTHER;
+    if ((flags & DNF_SACK_ADD_FLAG_UPDATEINFO) > 0)
+        flags_hy |= DNF_SACK_LOAD_FLAG_USE_UPDATEINFO;
+    return flags_hy;
+}
+
+// Check or refresh the repo metadata; @loadable is set to FALSE when the repo
+// should be skipped without an error
+static gboolean
+dnf_sack_check_repo(DnfRepo *repo,
                     guint permissible_cache_age,
-                    DnfSackAddFlags flags,
                     DnfState *state,
-                    GError **error) try
+                    gboolean *loadable,
+                    GError **error)
 {
-    gboolean ret = TRUE;
     GError *error_local = NULL;
-    DnfState *state_local;
-    int flags_hy = DNF_SACK_LOAD_FLAG_BUILD_CACHE;
 
-    /* set state */
-    ret = dnf_state_set_steps(state, error,
-                   5, /* check repo */
-                   95, /* load solv */
-                   -1);
-    if (!ret)
-        return FALSE;
-
-    /* check repo */
-    state_local = dnf_state_get_child(state);
-    ret = dnf_repo_check(repo,
-                         permissible_cache_age,
-                         state_local,
-                         &error_local);
-    if (!ret) {
+    *loadable = FALSE;
+    if (!dnf_repo_check(repo, permissible_cache_age, state, &error_local)) {
         g_debug("failed to check, attempting update: %s",
                 error_local->message);
         g_clear_error(&error_local);
-        dnf_state_reset(state_local);
-        ret = dnf_repo_update(repo,
-                              DNF_REPO_UPDATE_FLAG_FORCE,
-                              state_local,
-                              &error_local);
-        if (!ret) {
+        dnf_state_reset(state);
+        if (!dnf_repo_update(repo, DNF_REPO_UPDATE_FLAG_FORCE, state, &error_local)) {
             if (!dnf_repo_get_required(repo) &&
                 (g_error_matches(error_local,
                                  DNF_ERROR,
@@ -2269,7 +2687,7 @@ dnf_sack_add_repo(DnfSack *sack,
                           dnf_repo_get_id(repo),
                           error_local->message);
                 g_error_free(error_local);
-                return dnf_state_finished(state, error);
+                return TRUE;
             }
             g_propagate_error(error, error_local);
             return FALSE;
@@ -2280,21 +2698,209 @@ dnf_sack_add_repo(DnfSack *sack,
     if (dnf_repo_get_enabled(repo) == DNF_REPO_ENABLED_NONE) {
         g_debug("Skipping %s as repo no longer enabled",
                 dnf_repo_get_id(repo));
-        return dnf_state_finished(state, error);
+        return TRUE;
     }
 
+    *loadable = TRUE;
+    return TRUE;
+}
+
+// Return TRUE when a usable primary solv cache for the repo already exists
+static gboolean
+dnf_sack_repo_cache_is_current(DnfSack *sack, HyRepo hrepo)
+{
+    auto repoImpl = libdnf::repoGetImpl(hrepo);
+    unsigned char checksum[CHKSUM_BYTES];
+
+    FILE *fp_repomd = fopen(repoImpl->repomdFn.c_str(), "r");
+    if (!fp_repomd)
+        return FALSE;
+    checksum_fp(checksum, fp_repomd);
+    fclose(fp_repomd);
+
+    g_autofree gchar *fn_cache = dnf_sack_give_cache_fn(sack, hrepo->getId().c_str(), NULL);
+    FILE *fp_cache = fopen(fn_cache, "r");
+    if (!fp_cache)
+        return FALSE;
+    auto solv_userdata = solv_userdata_read(fp_cache);
+    fclose(fp_cache);
+    return solv_userdata && solv_userdata_verify(solv_userdata.get(), checksum);
+}
+
+namespace {
+
+/* A repo whose solv caches are built in a private sack on a worker thread */
+struct StagedRepo {
+    DnfRepo *repo;
+    DnfSack *sack;
+    HyRepo hrepo;
+    gboolean ret;
+    GError *error;
+};
+
+}
+
+// Parse the repo metadata into a private sack and write the solv cache files.
+// The main sack then loads the repo from these files, so the result is the
+// same as if it had parsed the metadata itself.
+static void
+dnf_sack_build_staged_repo_cache(StagedRepo *staged, int flags)
+{
+    staged->ret = dnf_sack_load_repo(staged->sack, staged->hrepo,
+                                     flags | DNF_SACK_LOAD_FLAG_BUILD_CACHE,
+                                     &staged->error);
+}
+
+static StagedRepo *
+dnf_sack_stage_repo(DnfSack *sack, DnfRepo *repo)
+{
+    HyRepo hrepo = dnf_repo_get_repo(repo);
+    auto repoImpl = libdnf::repoGetImpl(hrepo);
+    const char *arch = dnf_sack_get_arch(sack);
+
+    auto staged = g_new0(StagedRepo, 1);
+    staged->repo = repo;
+    staged->sack = dnf_sack_new();
+    dnf_sack_set_cachedir(staged->sack, dnf_sack_get_cache_dir(sack));
+    if (arch)
+        dnf_sack_set_arch(staged->sack, arch, NULL);
+    else
+        dnf_sack_set_all_arch(staged->sack, TRUE);
+
+    staged->hrepo = hy_repo_create(hrepo->getId().c_str());
+    auto stagedImpl = libdnf::repoGetImpl(staged->hrepo);
+    stagedImpl->repomdFn = repoImpl->repomdFn;
+    stagedImpl->metadataPaths = repoImpl->metadataPaths;
+    return staged;
+}
+
+static void
+dnf_sack_staged_repo_free(StagedRepo *staged)
+{
+    /* the sack holds a reference to the repo, drop it first */
+    g_object_unref(staged->sack);
+    hy_repo_free(staged->hrepo);
+    if (staged->error)
+        g_error_free(staged->error);
+    g_free(staged);
+}
+
+// Build the missing solv caches of all the repos concurrently, reporting one
+// step of @state per finished repo
+static gboolean
+dnf_sack_build_repo_caches(DnfSack *sack,
+                           GPtrArray *repos,
+                           int flags,
+                           DnfState *state,
+                           GError **error)
+{
+    /* the main sack only reuses what was staged if the caches get written,
+     * otherwise it would parse the metadata a second time */
+    const char *cachedir = dnf_sack_get_cache_dir(sack);
+    gboolean can_stage = (flags & DNF_SACK_LOAD_FLAG_BUILD_CACHE) &&
+        cachedir && access(cachedir, W_OK) == 0;
+
+    std::vector<StagedRepo *> staged_repos;
+    for (guint i = 0; can_stage && i < repos->len; i++) {
+        auto repo = static_cast<DnfRepo *>(g_ptr_array_index(repos, i));
+        if (dnf_sack_repo_cache_is_current(sack, dnf_repo_get_repo(repo)))
+            continue;
+        staged_repos.push_back(dnf_sack_stage_repo(sack, repo));
+    }
+
+    /* repos with a valid cache are done already */
+    dnf_state_set_number_steps(state, repos->len);
+    for (guint i = staged_repos.size(); i < repos->len; i++) {
+        if (!dnf_state_done(state, error)) {
+            for (auto staged : staged_repos)
+                dnf_sack_staged_repo_free(staged);
+            return FALSE;
+        }
+    }
+    if (staged_repos.empty())
+        return TRUE;
+
+    std::mutex finished_mutex;
+    std::condition_variable finished_cond;
+    std::vector<StagedRepo *> finished;
+    std::atomic<size_t> next_staged{0};
+
+    auto worker = [&]() {
+        for (size_t i = next_staged++; i < staged_repos.size(); i = next_staged++) {
+            dnf_sack_build_staged_repo_cache(staged_repos[i], flags);
+            std::lock_guard<std::mutex> guard(finished_mutex);
+            finished.push_back(staged_repos[i]);
+            finished_cond.notify_one();
+        }
+    };
+
+    size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::min(nthreads, staged_repos.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nthreads; i++)
+        threads.emplace_back(worker);
+
+    /* DnfState is not thread safe, report the progress from this thread;
+     * a worker never touches a repo again once it is finished, so each one
+     * is freed here right away instead of holding all the sacks until the end */
+    gboolean ret = TRUE;
+    for (size_t ndone = 0; ndone < staged_repos.size(); ndone++) {
+        StagedRepo *staged;
+        {
+            std::unique_lock<std::mutex> lock(finished_mutex);
+            finished_cond.wait(lock, [&]() { return !finished.empty(); });
+            staged = finished.back();
+            finished.pop_back();
+        }
+        /* a failure is left to the sequential load to report */
+        if (!staged->ret && staged->error)
+            g_debug("Failed to prepare cache for %s: %s",
+                    dnf_repo_get_id(staged->repo), staged->error->message);
+        dnf_sack_staged_repo_free(staged);
+        if (ret && !dnf_state_done(state, error))
+            ret = FALSE;
+    }
+
+    for (auto & thread : threads)
+        thread.join();
+    return ret;
+}
+
+/**
+ * dnf_sack_add_repo:
+ */
+gboolean
+dnf_sack_add_repo(DnfSack *sack,
+                    DnfRepo *repo,
+                    guint permissible_cache_age,
+                    DnfSackAddFlags flags,
+                    DnfState *state,
+                    GError **error) try
+{
+    gboolean ret = TRUE;
+    gboolean loadable;
+    DnfState *state_local;
+    int flags_hy = dnf_sack_add_flags_to_load_flags(flags);
+
+    /* set state */
+    ret = dnf_state_set_steps(state, error,
+                   5, /* check repo */
+                   95, /* load solv */
+                   -1);
+    if (!ret)
+        return FALSE;
+
+    /* check repo */
+    state_local = dnf_state_get_child(state);
+    if (!dnf_sack_check_repo(repo, permissible_cache_age, state_local, &loadable, error))
+        return FALSE;
+    if (!loadable)
+        return dnf_state_finished(state, error);
+
     /* done */
     if (!dnf_state_done(state, error))
         return FALSE;
 
-    /* only load what's required */
-    if ((flags & DNF_SACK_ADD_FLAG_FILELISTS) > 0)
-        flags_hy |= DNF_SACK_LOAD_FLAG_USE_FILELISTS;
-    if ((flags & DNF_SACK_ADD_FLAG_OTHER) > 0)
-        flags_hy |= DNF_SACK_LOAD_FLAG_USE_OTHER;
-    if ((flags & DNF_SACK_ADD_FLAG_UPDATEINFO) > 0)
-        flags_hy |= DNF_SACK_LOAD_FLAG_USE_UPDATEINFO;
-
     /* load solv */
     g_debug("Loading repo %s", dnf_repo_get_id(repo));
     dnf_state_action_start(state, DNF_STATE_ACTION_LOADING_CACHE, NULL);
@@ -2307,6 +2913,10 @@ dnf_sack_add_repo(DnfSack *sack,
 
 /**
  * dnf_sack_add_repos:
+ *
+ * The repos are checked one after another, then the metadata of all the repos
+ * without a valid solv cache are parsed concurrently and finally the repos are
+ * loaded into the sack in their original order.
  */
 gboolean
 dnf_sack_add_repos(DnfSack *sack,
@@ -2317,13 +2927,16 @@ dnf_sack_add_repos(DnfSack *sack,
                      GError **error) try
 {
     gboolean ret;
-    guint cnt = 0;
+    gboolean loadable;
     guint i;
     DnfRepo *repo;
     DnfState *state_local;
+    DnfState *state_loop;
+    int flags_hy = dnf_sack_add_flags_to_load_flags(flags);
     g_autoptr(GPtrArray) enabled_repos = g_ptr_array_new();
+    g_autoptr(GPtrArray) loadable_repos = g_ptr_array_new();
 
-    /* count the enabled repos */
+    /* collect the enabled repos */
     for (i = 0; i < repos->len; i++) {
         repo = static_cast<DnfRepo *>(g_ptr_array_index(repos, i));
         if (dnf_repo_get_enabled(repo) == DNF_REPO_ENABLED_NONE)
@@ -2335,38 +2948,56 @@ dnf_sack_add_repos(DnfSack *sack,
                 continue;
         }
 
-        cnt++;
+        g_ptr_array_add(enabled_repos, repo);
     }
 
-    /* add each repo */
-    dnf_state_set_number_steps(state, cnt);
-    for (i = 0; i < repos->len; i++) {
-        repo = static_cast<DnfRepo *>(g_ptr_array_index(repos, i));
-        if (dnf_repo_get_enabled(repo) == DNF_REPO_ENABLED_NONE)
-            continue;
-
-        /* only allow metadata-only repos if FLAG_UNAVAILABLE is set */
-        if (dnf_repo_get_enabled(repo) == DNF_REPO_ENABLED_METADATA) {
-            if ((flags & DNF_SACK_ADD_FLAG_UNAVAILABLE) == 0)
-                continue;
-        }
+    /* set state */
+    ret = dnf_state_set_steps(state, error,
+                   5, /* check repos */
+                   75, /* build caches */
+                   20, /* load solv */
+                   -1);
+    if (!ret)
+        return FALSE;
 
-        state_local = dnf_state_get_child(state);
-        ret = dnf_sack_add_repo(sack,
-                                  repo,
-                                  permissible_cache_age,
-                                  flags,
-                                  state_local,
-                                  error);
-        if (!ret)
+    /* check each repo */
+    state_local = dnf_state_get_child(state);
+    dnf_state_set_number_steps(state_local, enabled_repos->len);
+    for (i = 0; i < enabled_repos->len; i++) {
+        repo = static_cast<DnfRepo *>(g_ptr_array_index(enabled_repos, i));
+        state_loop = dnf_state_get_child(state_local);
+        if (!dnf_sack_check_repo(repo, permissible_cache_age, state_loop, &loadable, error))
             return FALSE;
+        if (loadable)
+            g_ptr_array_add(loadable_repos, repo);
+        if (!dnf_state_done(state_local, error))
+            return FALSE;
+    }
+    if (!dnf_state_done(state, error))
+        return FALSE;
 
-        g_ptr_array_add(enabled_repos, repo);
+    /* parse the metadata of all the repos without a cache in parallel */
+    state_local = dnf_state_get_child(state);
+    dnf_state_action_start(state_local, DNF_STATE_ACTION_LOADING_CACHE, NULL);
+    if (!dnf_sack_build_repo_caches(sack, loadable_repos, flags_hy, state_local, error))
+        return FALSE;
+    if (!dnf_state_done(state, error))
+        return FALSE;
 
-        /* done */
-        if (!dnf_state_done(state, error))
+    /* load each repo in order */
+    state_local = dnf_state_get_child(state);
+    dnf_state_set_number_steps(state_local, loadable_repos->len);
+    for (i = 0; i < loadable_repos->len; i++) {
+        repo = static_cast<DnfRepo *>(g_ptr_array_index(loadable_repos, i));
+        g_debug("Loading repo %s", dnf_repo_get_id(repo));
+        dnf_state_action_start(state_local, DNF_STATE_ACTION_LOADING_CACHE, NULL);
+        if (!dnf_sack_load_repo(sack, dnf_repo_get_repo(repo), flags_hy, error))
+            return FALSE;
+        if (!dnf_state_done(state_local, error))
             return FALSE;
     }
+    if (!dnf_state_done(state, error))
+        return FALSE;
 
     process_excludes(sack, enabled_repos);
 
@@ -163,6 +163,8 @@ gboolean     dnf_sack_load_system_repo      (DnfSack        *sack,
                                              HyRepo          a_hrepo,
                                              int             flags,
                                              GError        **error);
+gboolean     dnf_sack_reload_system_repo    (DnfSack        *sack,
+                                             GError        **error);
 gboolean     dnf_sack_load_repo             (DnfSack        *sack,
                                              HyRepo          hrepo,
                                              int             flags,
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __DNF_TRANSACTION_PRIVATE_HPP
+#define __DNF_TRANSACTION_PRIVATE_HPP
+
+#include <rpm/header.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "dnf-types.h"
+
+/**
+ * DnfPackageIndex:
+ *
+ * Hash lookups over one of the package arrays of the transaction, the
+ * rpm callback resolves every element through these. As with a scan of
+ * the array, the first package with a given key wins.
+ **/
+struct DnfPackageIndex {
+    explicit DnfPackageIndex(GPtrArray *array);
+    ~DnfPackageIndex() { g_ptr_array_unref(array); }
+
+    GPtrArray *array;
+    std::unordered_map<std::string, DnfPackage *> byFilename;
+    std::unordered_map<std::string, DnfPackage *> byNevra;
+    std::unordered_map<std::string, DnfPackage *> byName;
+};
+
+DnfPackage      *dnf_find_pkg_from_header       (DnfPackageIndex *index,
+                                                 Header          hdr);
+DnfPackage      *dnf_find_pkg_from_filename_suffix(DnfPackageIndex *index,
+                                                 const gchar     *filename_suffix);
+DnfPackage      *dnf_find_pkg_from_name         (DnfPackageIndex *index,
+                                                 const gchar     *pkgname);
+
+#endif /* __DNF_TRANSACTION_PRIVATE_HPP */
@@ -33,6 +33,12 @@
 #include <rpm/rpmlog.h>
 #include <rpm/rpmts.h>
 
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "catch-error.hpp"
 #include "log.hpp"
 #include "tinyformat/tinyformat.hpp"
@@ -44,6 +50,7 @@
 #include "dnf-sack.h"
 #include "dnf-sack-private.hpp"
 #include "dnf-transaction.h"
+#include "dnf-transaction-private.hpp"
 #include "dnf-types.h"
 #include "dnf-utils.h"
 #include "hy-query.h"
@@ -63,6 +70,43 @@ typedef enum {
     DNF_TRANSACTION_STEP_IGNORE
 } DnfTransactionStep;
 
+static std::string
+dnf_package_index_nevra_key(const gchar *name,
+                            guint64 epoch,
+                            const gchar *version,
+                            const gchar *release,
+                            const gchar *arch)
+{
+    /* none of the fields can contain a newline */
+    std::string key(name);
+    key.append("\n").append(std::to_string(epoch));
+    key.append("\n").append(version ? version : "");
+    key.append("\n").append(release ? release : "");
+    key.append("\n").append(arch ? arch : "");
+    return key;
+}
+
+DnfPackageIndex::DnfPackageIndex(GPtrArray *array)
+: array(g_ptr_array_ref(array))
+{
+    for (guint i = 0; i < array->len; i++) {
+        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(array, i));
+        auto name = dnf_package_get_name(pkg);
+        auto filename = dnf_package_get_filename(pkg);
+        if (filename != NULL)
+            byFilename.emplace(filename, pkg);
+        if (name == NULL)
+            continue;
+        byNevra.emplace(dnf_package_index_nevra_key(name,
+                                                    dnf_package_get_epoch(pkg),
+                                                    dnf_package_get_version(pkg),
+                                                    dnf_package_get_release(pkg),
+                                                    dnf_package_get_arch(pkg)),
+                        pkg);
+        byName.emplace(name, pkg);
+    }
+}
+
 typedef struct {
     rpmKeyring keyring;
     rpmts ts;
@@ -80,6 +124,9 @@ typedef struct {
     GPtrArray *remove;
     GPtrArray *remove_helper;
     GPtrArray *install;
+    DnfPackageIndex *remove_index;
+    DnfPackageIndex *remove_helper_index;
+    DnfPackageIndex *install_index;
     GPtrArray *pkgs_to_download;
     GHashTable *erased_by_package_hash;
     guint64 flags;
@@ -131,6 +178,9 @@ dnf_transaction_finalize(GObject *object)
         g_ptr_array_unref(priv->remove);
     if (priv->remove_helper != NULL)
         g_ptr_array_unref(priv->remove_helper);
+    delete priv->install_index;
+    delete priv->remove_index;
+    delete priv->remove_helper_index;
     if (priv->erased_by_package_hash != NULL)
         g_hash_table_unref(priv->erased_by_package_hash);
     if (priv->context != NULL)
@@ -356,18 +406,20 @@ dnf_transaction_ensure_repo_list(DnfTransaction *transaction, GPtrArray *pkglist
     return TRUE;
 } CATCH_TO_GERROR(FALSE)
 
-gboolean
-dnf_transaction_gpgcheck_package(DnfTransaction *transaction, DnfPackage *pkg, GError **error) try
+/**
+ * dnf_transaction_gpgcheck_prepare:
+ *
+ * Returns the local file of @pkg that has to be verified.
+ */
+static const gchar *
+dnf_transaction_gpgcheck_prepare(DnfTransaction *transaction, DnfPackage *pkg, GError **error)
 {
-    DnfTransactionPrivate *priv = GET_PRIVATE(transaction);
-    GError *error_local = NULL;
-    DnfRepo *repo;
     const gchar *fn;
 
     /* ensure the filename is set */
     if (!dnf_transaction_ensure_repo(transaction, pkg, error)) {
         g_prefix_error(error, _("Failed to check untrusted: "));
-        return FALSE;
+        return NULL;
     }
 
     /* find the location of the local file */
@@ -378,43 +430,73 @@ dnf_transaction_gpgcheck_package(DnfTransaction *transaction, DnfPackage *pkg, G
                     DNF_ERROR_FILE_NOT_FOUND,
                     _("Downloaded file for %s not found"),
                     dnf_package_get_name(pkg));
-        return FALSE;
+        return NULL;
     }
+    return fn;
+}
 
-    /* check file */
-    if (!dnf_keyring_check_untrusted_file(priv->keyring, fn, &error_local)) {
+/**
+ * dnf_transaction_gpgcheck_result:
+ *
+ * Decides whether the outcome of verifying @pkg is fatal, taking
+ * ownership of @error_local.
+ */
+static gboolean
+dnf_transaction_gpgcheck_result(DnfTransaction *transaction,
+                                DnfPackage *pkg,
+                                GError *error_local,
+                                GError **error)
+{
+    DnfTransactionPrivate *priv = GET_PRIVATE(transaction);
+    DnfRepo *repo;
 
-        /* probably an i/o error */
-        if (!g_error_matches(error_local, DNF_ERROR, DNF_ERROR_GPG_SIGNATURE_INVALID)) {
-            g_propagate_error(error, error_local);
-            return FALSE;
-        }
+    if (error_local == NULL)
+        return TRUE;
 
-        /* if the repo is signed this is ALWAYS an error */
-        repo = dnf_package_get_repo(pkg);
-        if (repo != NULL && dnf_repo_get_gpgcheck(repo)) {
-            g_set_error(error,
-                        DNF_ERROR,
-                        DNF_ERROR_FILE_INVALID,
-                        _("package %1$s cannot be verified "
-                          "and repo %2$s is GPG enabled: %3$s"),
-                        dnf_package_get_nevra(pkg),
-                        dnf_repo_get_id(repo),
-                        error_local->message);
-            g_error_free(error_local);
-            return FALSE;
-        }
+    /* probably an i/o error */
+    if (!g_error_matches(error_local, DNF_ERROR, DNF_ERROR_GPG_SIGNATURE_INVALID)) {
+        g_propagate_error(error, error_local);
+        return FALSE;
+    }
 
-        /* we can only install signed packages in this mode */
-        if ((priv->flags & DNF_TRANSACTION_FLAG_ONLY_TRUSTED) > 0) {
-            g_propagate_error(error, error_local);
-            return FALSE;
-        } else {
-            g_clear_error(&error_local);
-        }
+    /* if the repo is signed this is ALWAYS an error */
+    repo = dnf_package_get_repo(pkg);
+    if (repo != NULL && dnf_repo_get_gpgcheck(repo)) {
+        g_set_error(error,
+                    DNF_ERROR,
+                    DNF_ERROR_FILE_INVALID,
+                    _("package %1$s cannot be verified "
+                      "and repo %2$s is GPG enabled: %3$s"),
+                    dnf_package_get_nevra(pkg),
+                    dnf_repo_get_id(repo),
+                    error_local->message);
+        g_error_free(error_local);
+        return FALSE;
     }
 
+    /* we can only install signed packages in this mode */
+    if ((priv->flags & DNF_TRANSACTION_FLAG_ONLY_TRUSTED) > 0) {
+        g_propagate_error(error, error_local);
+        return FALSE;
+    }
+    g_error_free(error_local);
     return TRUE;
+}
+
+gboolean
+dnf_transaction_gpgcheck_package(DnfTransaction *transaction, DnfPackage *pkg, GError **error) try
+{
+    DnfTransactionPrivate *priv = GET_PRIVATE(transaction);
+    GError *error_local = NULL;
+    const gchar *fn;
+
+    fn = dnf_transaction_gpgcheck_prepare(transaction, pkg, error);
+    if (fn == NULL)
+        return FALSE;
+
+    /* check file */
+    dnf_keyring_check_untrusted_file(priv->keyring, fn, &error_local);
+    return dnf_transaction_gpgcheck_result(transaction, pkg, error_local, error);
 } CATCH_TO_GERROR(FALSE)
 
 /**
@@ -425,10 +507,14 @@ dnf_transaction_gpgcheck_package(DnfTransaction *transaction, DnfPackage *pkg, G
  *
  * Verify GPG signatures for all pending packages to be changed as part
  * of @goal.
+ *
+ * The signatures are verified in parallel, errors are reported for the
+ * first failing package in the same order as dnf_goal_get_packages().
  */
 gboolean
 dnf_transaction_check_untrusted(DnfTransaction *transaction, HyGoal goal, GError **error) try
 {
+    DnfTransactionPrivate *priv = GET_PRIVATE(transaction);
     guint i;
     g_autoptr(GPtrArray) install = NULL;
 
@@ -442,63 +528,100 @@ dnf_transaction_check_untrusted(DnfTransaction *transaction, HyGoal goal, GError
     if (install->len == 0)
         return TRUE;
 
-    /* find any packages in untrusted repos */
+    /* the repos and the sack are not thread safe, resolve the files
+     * here; a failure only stops the packages after it */
+    std::vector<const gchar *> files;
+    std::vector<bool> must_verify;
+    GError *prepare_error = NULL;
     for (i = 0; i < install->len; i++) {
         auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(install, i));
+        const gchar *fn = dnf_transaction_gpgcheck_prepare(transaction, pkg, &prepare_error);
+        if (fn == NULL)
+            break;
+        DnfRepo *repo = dnf_package_get_repo(pkg);
+        files.push_back(fn);
+        must_verify.push_back((repo != NULL && dnf_repo_get_gpgcheck(repo)) ||
+                              (priv->flags & DNF_TRANSACTION_FLAG_ONLY_TRUSTED) > 0);
+    }
 
-        if (!dnf_transaction_gpgcheck_package(transaction, pkg, error))
-            return FALSE;
+    /* find any packages in untrusted repos */
+    std::vector<GError *> results(files.size(), nullptr);
+    std::atomic<size_t> next_file{0};
+    std::atomic<size_t> first_fatal{files.size()};
+
+    auto worker = [&]() {
+        for (size_t j = next_file++; j < files.size(); j = next_file++) {
+            /* nothing after the first fatal failure will be looked at */
+            if (j > first_fatal)
+                continue;
+            if (dnf_keyring_check_untrusted_file(priv->keyring, files[j], &results[j]))
+                continue;
+            if (!must_verify[j] &&
+                g_error_matches(results[j], DNF_ERROR, DNF_ERROR_GPG_SIGNATURE_INVALID))
+                continue;
+            size_t fatal = first_fatal;
+            while (j < fatal && !first_fatal.compare_exchange_weak(fatal, j))
+                ;
+        }
+    };
+
+    size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::min(nthreads, files.size());
+    std::vector<std::thread> threads;
+    for (size_t j = 0; j < nthreads; j++)
+        threads.emplace_back(worker);
+    for (auto & thread : threads)
+        thread.join();
+
+    gboolean ret = TRUE;
+    for (i = 0; i < results.size(); i++) {
+        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(install, i));
+        if (ret)
+            ret = dnf_transaction_gpgcheck_result(transaction, pkg, results[i], error);
+        else if (results[i] != NULL)
+            g_error_free(results[i]);
     }
-    return TRUE;
+    if (ret && prepare_error != NULL) {
+        g_propagate_error(error, prepare_error);
+        ret = FALSE;
+    } else if (prepare_error != NULL) {
+        g_error_free(prepare_error);
+    }
+    return ret;
 } CATCH_TO_GERROR(FALSE)
 
 /**
  * dnf_find_pkg_from_header:
  **/
-static DnfPackage *
-dnf_find_pkg_from_header(GPtrArray *array, Header hdr)
+DnfPackage *
+dnf_find_pkg_from_header(DnfPackageIndex *index, Header hdr)
 {
-    const gchar *arch;
-    const gchar *name;
-    const gchar *release;
-    const gchar *version;
-    guint epoch;
-    guint i;
-
-    /* get details */
-    name = headerGetString(hdr, RPMTAG_NAME);
-    epoch = headerGetNumber(hdr, RPMTAG_EPOCH);
-    version = headerGetString(hdr, RPMTAG_VERSION);
-    release = headerGetString(hdr, RPMTAG_RELEASE);
-    arch = headerGetString(hdr, RPMTAG_ARCH);
-
-    /* find in array */
-    for (i = 0; i < array->len; i++) {
-        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(array, i));
-        if (g_strcmp0(name, dnf_package_get_name(pkg)) != 0)
-            continue;
-        if (g_strcmp0(version, dnf_package_get_version(pkg)) != 0)
-            continue;
-        if (g_strcmp0(release, dnf_package_get_release(pkg)) != 0)
-            continue;
-        if (g_strcmp0(arch, dnf_package_get_arch(pkg)) != 0)
-            continue;
-        if (epoch != dnf_package_get_epoch(pkg))
-            continue;
-        return pkg;
-    }
-    return NULL;
+    const gchar *name = headerGetString(hdr, RPMTAG_NAME);
+    if (name == NULL)
+        return NULL;
+
+    auto it = index->byNevra.find(dnf_package_index_nevra_key(name,
+                                                              headerGetNumber(hdr, RPMTAG_EPOCH),
+                                                              headerGetString(hdr, RPMTAG_VERSION),
+                                                              headerGetString(hdr, RPMTAG_RELEASE),
+                                                              headerGetString(hdr, RPMTAG_ARCH)));
+    return it == index->byNevra.end() ? NULL : it->second;
 }
 
 /**
  * dnf_find_pkg_from_filename_suffix:
  **/
-static DnfPackage *
-dnf_find_pkg_from_filename_suffix(GPtrArray *array, const gchar *filename_suffix)
+DnfPackage *
+dnf_find_pkg_from_filename_suffix(DnfPackageIndex *index, const gchar *filename_suffix)
 {
+    /* rpm hands back the full filename we added the element with */
+    auto it = index->byFilename.find(filename_suffix);
+    if (it != index->byFilename.end())
+        return it->second;
+
     /* find in array */
-    for (guint i = 0; i < array->len; i++) {
-        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(array, i));
+    for (guint i = 0; i < index->array->len; i++) {
+        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(index->array, i));
         auto filename = dnf_package_get_filename(pkg);
         if (filename == NULL)
             continue;
@@ -511,18 +634,13 @@ dnf_find_pkg_from_filename_suffix(GPtrArray *array, const gchar *filename_suffix
 /**
  * dnf_find_pkg_from_name:
  **/
-static DnfPackage *
-dnf_find_pkg_from_name(GPtrArray *array, const gchar *pkgname)
+DnfPackage *
+dnf_find_pkg_from_name(DnfPackageIndex *index, const gchar *pkgname)
 {
-    guint i;
-
-    /* find in array */
-    for (i = 0; i < array->len; i++) {
-        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(array, i));
-        if (g_strcmp0(dnf_package_get_name(pkg), pkgname) == 0)
-            return pkg;
-    }
-    return NULL;
+    if (pkgname == NULL)
+        return NULL;
+    auto it = index->byName.find(pkgname);
+    return it == index->byName.end() ? NULL : it->second;
 }
 
 static void
@@ -596,7 +714,7 @@ dnf_transaction_ts_progress_cb(const void *arg,
         case RPMCALLBACK_INST_START:
 
             /* find pkg */
-            pkg = dnf_find_pkg_from_filename_suffix(priv->install, filename);
+            pkg = dnf_find_pkg_from_filename_suffix(priv->install_index, filename);
             if (pkg == NULL)
                 g_assert_not_reached();
 
@@ -625,14 +743,14 @@ dnf_transaction_ts_progress_cb(const void *arg,
         case RPMCALLBACK_UNINST_START:
 
             /* find pkg */
-            pkg = dnf_find_pkg_from_header(priv->remove, hdr);
+            pkg = dnf_find_pkg_from_header(priv->remove_index, hdr);
             if (pkg == NULL && filename != NULL) {
-                pkg = dnf_find_pkg_from_filename_suffix(priv->remove, filename);
+                pkg = dnf_find_pkg_from_filename_suffix(priv->remove_index, filename);
             }
             if (pkg == NULL && name != NULL)
-                pkg = dnf_find_pkg_from_name(priv->remove, name);
+                pkg = dnf_find_pkg_from_name(priv->remove_index, name);
             if (pkg == NULL && name != NULL)
-                pkg = dnf_find_pkg_from_name(priv->remove_helper, name);
+                pkg = dnf_find_pkg_from_name(priv->remove_helper_index, name);
             if (pkg == NULL) {
                 g_warning("cannot find %s in uninst-start", name);
                 priv->step = DNF_TRANSACTION_STEP_WRITING;
@@ -673,9 +791,9 @@ dnf_transaction_ts_progress_cb(const void *arg,
                 dnf_state_set_percentage(priv->child, percentage);
 
             /* update UI */
-            pkg = dnf_find_pkg_from_header(priv->install, hdr);
+            pkg = dnf_find_pkg_from_header(priv->install_index, hdr);
             if (pkg == NULL) {
-                pkg = dnf_find_pkg_from_filename_suffix(priv->install, filename);
+                pkg = dnf_find_pkg_from_filename_suffix(priv->install_index, filename);
             }
             if (pkg == NULL) {
                 g_debug("cannot find %s(%s)", filename, name);
@@ -701,14 +819,14 @@ dnf_transaction_ts_progress_cb(const void *arg,
                 dnf_state_set_percentage(priv->child, percentage);
 
             /* update UI */
-            pkg = dnf_find_pkg_from_header(priv->remove, hdr);
+            pkg = dnf_find_pkg_from_header(priv->remove_index, hdr);
             if (pkg == NULL && filename != NULL) {
-                pkg = dnf_find_pkg_from_filename_suffix(priv->remove, filename);
+                pkg = dnf_find_pkg_from_filename_suffix(priv->remove_index, filename);
             }
             if (pkg == NULL && name != NULL)
-                pkg = dnf_find_pkg_from_name(priv->remove, name);
+                pkg = dnf_find_pkg_from_name(priv->remove_index, name);
             if (pkg == NULL && name != NULL)
-                pkg = dnf_find_pkg_from_name(priv->remove_helper, name);
+                pkg = dnf_find_pkg_from_name(priv->remove_helper_index, name);
             if (pkg == NULL) {
                 g_warning("cannot find %s in uninst-progress", name);
                 break;
@@ -740,9 +858,9 @@ dnf_transaction_ts_progress_cb(const void *arg,
             break;
 
         case RPMCALLBACK_INST_STOP:
-            pkg = dnf_find_pkg_from_header(priv->install, hdr);
+            pkg = dnf_find_pkg_from_header(priv->install_index, hdr);
             if (pkg == NULL && filename != NULL) {
-                pkg = dnf_find_pkg_from_filename_suffix(priv->install, filename);
+                pkg = dnf_find_pkg_from_filename_suffix(priv->install_index, filename);
             }
 
             // transaction item install complete
@@ -757,18 +875,18 @@ dnf_transaction_ts_progress_cb(const void *arg,
 
         case RPMCALLBACK_UNINST_STOP:
 
-            pkg = dnf_find_pkg_from_header(priv->remove, hdr);
+            pkg = dnf_find_pkg_from_header(priv->remove_index, hdr);
             if (pkg == NULL) {
-                pkg = dnf_find_pkg_from_header(priv->remove_helper, hdr);
+                pkg = dnf_find_pkg_from_header(priv->remove_helper_index, hdr);
             }
             if (pkg == NULL && filename != NULL) {
-                pkg = dnf_find_pkg_from_filename_suffix(priv->remove, filename);
+                pkg = dnf_find_pkg_from_filename_suffix(priv->remove_index, filename);
             }
             if (pkg == NULL && name != NULL) {
-                pkg = dnf_find_pkg_from_name(priv->remove, name);
+                pkg = dnf_find_pkg_from_name(priv->remove_index, name);
             }
             if (pkg == NULL && name != NULL) {
-                pkg = dnf_find_pkg_from_name(priv->remove_helper, name);
+                pkg = dnf_find_pkg_from_name(priv->remove_helper_index, name);
             }
 
             // transaction item remove complete
@@ -1057,6 +1175,12 @@ dnf_transaction_reset(DnfTransaction *transaction)
         g_ptr_array_unref(priv->remove_helper);
         priv->remove_helper = NULL;
     }
+    delete priv->install_index;
+    priv->install_index = NULL;
+    delete priv->remove_index;
+    priv->remove_index = NULL;
+    delete priv->remove_helper_index;
+    priv->remove_helper_index = NULL;
     if (priv->erased_by_package_hash != NULL) {
         g_hash_table_unref(priv->erased_by_package_hash);
         priv->erased_by_package_hash = NULL;
@@ -1264,6 +1388,7 @@ dnf_transaction_commit(DnfTransaction *transaction, HyGoal goal, DnfState *state
         if (!ret)
             goto out;
     }
+    priv->install_index = new DnfPackageIndex(priv->install);
 
     /* this section done */
     ret = dnf_state_done(state, error);
@@ -1273,6 +1398,7 @@ dnf_transaction_commit(DnfTransaction *transaction, HyGoal goal, DnfState *state
     /* add things to remove */
     priv->remove =
         dnf_goal_get_packages(goal, DNF_PACKAGE_INFO_OBSOLETE, DNF_PACKAGE_INFO_REMOVE, -1);
+    priv->remove_index = new DnfPackageIndex(priv->remove);
     for (i = 0; i < priv->remove->len; i++) {
         pkg = static_cast< DnfPackage * >(g_ptr_array_index(priv->remove, i));
         ret = dnf_rpmts_add_remove_pkg(priv->ts, pkg, error);
@@ -1288,7 +1414,7 @@ dnf_transaction_commit(DnfTransaction *transaction, HyGoal goal, DnfState *state
         libdnf::TransactionItemAction swdbAction = libdnf::TransactionItemAction::REMOVE;
 
         /* are the things being removed actually being upgraded */
-        pkg_tmp = dnf_find_pkg_from_name(priv->install, dnf_package_get_name(pkg));
+        pkg_tmp = dnf_find_pkg_from_name(priv->install_index, dnf_package_get_name(pkg));
         if (pkg_tmp != NULL) {
             dnf_package_set_action(pkg, DNF_STATE_ACTION_CLEANUP);
             if (dnf_package_evr_cmp(pkg, pkg_tmp)) {
@@ -1320,7 +1446,7 @@ dnf_transaction_commit(DnfTransaction *transaction, HyGoal goal, DnfState *state
 
             const char *pkg_tmp_name = dnf_package_get_name(pkg_tmp);
 
-            if (dnf_find_pkg_from_name(priv->remove, pkg_tmp_name) != NULL) {
+            if (dnf_find_pkg_from_name(priv->remove_index, pkg_tmp_name) != NULL) {
                 // package is already in remove set - skip resolution
                 continue;
             }
@@ -1336,7 +1462,7 @@ dnf_transaction_commit(DnfTransaction *transaction, HyGoal goal, DnfState *state
             }
 
             if (swdbAction == libdnf::TransactionItemAction::OBSOLETED
-                && dnf_find_pkg_from_name(priv->install, pkg_tmp_name) != NULL
+                && dnf_find_pkg_from_name(priv->install_index, pkg_tmp_name) != NULL
                 && g_strcmp0(pkg_name, pkg_tmp_name) != 0) {
                     // If a package is obsoleted and there's a package with the same name
                     // in the install set, skip recording the obsolete in the history db
@@ -1362,6 +1488,7 @@ dnf_transaction_commit(DnfTransaction *transaction, HyGoal goal, DnfState *state
         g_ptr_array_add(priv->remove_helper, g_object_ref(pkg_tmp));
     }
     g_ptr_array_unref(pkglist);
+    priv->remove_helper_index = new DnfPackageIndex(priv->remove_helper);
 
     /* this section done */
     ret = dnf_state_done(state, error);
@@ -34,12 +34,15 @@ public:
     ~Impl();
 private:
     friend Goal;
+    friend GoalSession;
     friend Query;
 
     DnfSack *sack;
     Queue staging;
     PackageSet exclude_from_weak;
     Solver *solv{nullptr};
+    /// pool->nsolvables when solv was created
+    int solverNsolvables{0};
     ::Transaction *trans{nullptr};
     DnfGoalActions actions{DNF_NONE};
     std::unique_ptr<PackageSet> protectedPkgs;
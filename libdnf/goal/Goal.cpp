@@ -18,10 +18,14 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <algorithm>
 #include <assert.h>
+#include <fnmatch.h>
 #include <map>
 #include <vector>
 #include <numeric>
+#include <unordered_map>
+#include <unordered_set>
 
 extern "C" {
 #include <solv/evr.h>
@@ -358,7 +362,6 @@ filterNameToJob(DnfSack *sack, const Filter *f, Queue *job)
     Pool *pool = dnf_sack_get_pool(sack);
     const char *name = f->getMatches()[0].str;
     Id id;
-    Dataiterator di;
 
     switch (f->getCmpType()) {
     case HY_EQ:
@@ -366,19 +369,24 @@ filterNameToJob(DnfSack *sack, const Filter *f, Queue *job)
         if (id)
             queue_push2(job, SOLVER_SOLVABLE_NAME, id);
         break;
-    case HY_GLOB:
-        dataiterator_init(&di, pool, 0, 0, SOLVABLE_NAME, name, SEARCH_GLOB);
-        while (dataiterator_step(&di)) {
-            if (!is_package(pool, pool_id2solvable(pool, di.solvid)))
+    case HY_GLOB: {
+        // distinct names come in the order of their first package, match each of them once
+        auto nameIndex = dnf_sack_get_name_index(sack);
+        for (const auto & nameEntry : nameIndex->getNames()) {
+            id = nameEntry.first;
+            if (fnmatch(name, pool_id2str(pool, id), 0) != 0)
                 continue;
-            assert(di.idp);
-            id = *di.idp;
-            if (jobHas(job, SOLVABLE_NAME, id))
+            // like a dataiterator, ignore names only present in disabled repos
+            auto range = nameIndex->byName(id);
+            auto enabled = std::find_if(range.first, range.second,
+                [pool](const std::pair<Id, Id> & entry)
+                { return !pool_id2solvable(pool, entry.second)->repo->disabled; });
+            if (enabled == range.second)
                 continue;
             queue_push2(job, SOLVER_SOLVABLE_NAME, id);
         }
-        dataiterator_free(&di);
         break;
+    }
     default:
         return INCORECT_COMPARISON_TYPE;
     }
@@ -675,6 +683,14 @@ Goal::Goal(DnfSack *sack) : pImpl(new Impl(sack)) {}
 
 Goal::~Goal() = default;
 
+void
+Goal::reset()
+{
+    bool protect_running_kernel = pImpl->protect_running_kernel;
+    pImpl.reset(new Impl(pImpl->sack));
+    pImpl->protect_running_kernel = protect_running_kernel;
+}
+
 Goal::Impl::~Impl()
 {
     if (trans)
@@ -830,6 +846,19 @@ Goal::reset_exclude_from_weak()
     pImpl->exclude_from_weak.clear();
 }
 
+const PackageSet &
+Goal::get_exclude_from_weak() const noexcept
+{
+    return pImpl->exclude_from_weak;
+}
+
+/* rich dependencies are not evaluated by the autodetection */
+static bool
+is_rich_dep(Pool * pool, Id dep)
+{
+    return pool_dep2str(pool, dep)[0] == '(';
+}
+
 void
 Goal::exclude_from_weak_autodetect()
 {
@@ -841,75 +870,95 @@ Goal::exclude_from_weak_autodetect()
     Query base_query(pImpl->sack);
     base_query.apply();
     auto * installed_pset = installed_query.getResultPset();
-    Id installed_id = -1;
-
-    std::vector<const char *> installed_names;
-    installed_names.reserve(installed_pset->size() + 1);
+    auto * base_pset = base_query.getResultPset();
+    Pool * pool = dnf_sack_get_pool(pImpl->sack);
+    dnf_sack_make_provides_ready(pImpl->sack);
+
+    // Providers are looked up once per dependency, installed packages share most of them
+    PackageSet excludes(pImpl->sack);
+    std::unordered_set<Id> seen_recommends;
+    Map installed_names;
+    map_init(&installed_names, pool->ss.nstrings);
+    IdQueue deps;
+    IdQueue providers;
 
     // Iterate over installed packages to detect unmet weak deps
+    Id installed_id = -1;
     while ((installed_id = installed_pset->next(installed_id)) != -1) {
-        g_autoptr(DnfPackage) pkg = dnf_package_new(pImpl->sack, installed_id);
-        installed_names.push_back(dnf_package_get_name(pkg));
-        std::unique_ptr<libdnf::DependencyContainer> recommends(dnf_package_get_recommends(pkg));
-        for (int i = 0; i < recommends->count(); ++i) {
-            std::unique_ptr<libdnf::Dependency> dep(recommends->getPtr(i));
-            const char * dep_string = dep->toString();
-            if (dep_string[0] == '(') {
+        Solvable * s = pool_id2solvable(pool, installed_id);
+        MAPSET(&installed_names, s->name);
+        queue_empty(deps.getQueue());
+        solvable_lookup_deparray(s, SOLVABLE_RECOMMENDS, deps.getQueue(), -1);
+        for (int i = 0; i < deps.size(); ++i) {
+            Id dep = deps[i];
+            if (!seen_recommends.insert(dep).second || is_rich_dep(pool, dep)) {
                 continue;
             }
-            Query query(base_query);
-            const char * version = dep->getVersion();
             //  There can be installed provider in different version or upgraded packed can recommend a different version
             //  Ignore version and search only by reldep name
+            const char * version = pool_id2evr(pool, dep);
             if (version && strlen(version) > 0) {
-                query.addFilter(HY_PKG_PROVIDES, HY_EQ, dep->getName());
-            } else {
-                query.addFilter(HY_PKG_PROVIDES, dep.get());
+                dep = pool_str2id(pool, pool_id2str(pool, dep), 0);
             }
-            // No providers of recommend => continue
-            if (query.empty()) {
-                continue;
+            bool installed_provider = false;
+            queue_empty(providers.getQueue());
+            Id p, pp;
+            FOR_PROVIDES(p, pp, dep) {
+                if (!base_pset->has(p)) {
+                    continue;
+                }
+                providers.pushBack(p);
+                if (pool_id2solvable(pool, p)->repo == pool->installed) {
+                    installed_provider = true;
+                }
             }
-            Query test_installed(query);
-            test_installed.installed();
             // when there is not installed any provider of recommend, exclude it
-            if (test_installed.empty()) {
-                add_exclude_from_weak(*query.getResultPset());
+            if (!installed_provider) {
+                for (int j = 0; j < providers.size(); ++j) {
+                    excludes.set(providers[j]);
+                }
             }
         }
     }
 
     // Investigate supplements of only available packages with a different name to installed packages
-    installed_names.push_back(nullptr);
-    base_query.addFilter(HY_PKG_NAME, HY_NEQ, installed_names.data());
-    auto * available_pset = base_query.getResultPset();
-    *available_pset -= *installed_pset;
+    std::unordered_map<Id, bool> supplement_installed;
     Id available_id = -1;
-    while ((available_id = available_pset->next(available_id)) != -1) {
-        g_autoptr(DnfPackage) pkg = dnf_package_new(pImpl->sack, available_id);
-        std::unique_ptr<libdnf::DependencyContainer> supplements(dnf_package_get_supplements(pkg));
-        if (supplements->count() == 0) {
+    while ((available_id = base_pset->next(available_id)) != -1) {
+        Solvable * s = pool_id2solvable(pool, available_id);
+        if (s->repo == pool->installed || MAPTST(&installed_names, s->name) ||
+            installed_pset->has(available_id)) {
             continue;
         }
-        libdnf::DependencyContainer supplements_without_rich(getSack());
-        for (int i = 0; i < supplements->count(); ++i) {
-            std::unique_ptr<libdnf::Dependency> dep(supplements->getPtr(i));
-            const char * dep_string = dep->toString();
-            if (dep_string[0] == '(') {
+        queue_empty(deps.getQueue());
+        solvable_lookup_deparray(s, SOLVABLE_SUPPLEMENTS, deps.getQueue(), -1);
+        for (int i = 0; i < deps.size(); ++i) {
+            Id dep = deps[i];
+            if (is_rich_dep(pool, dep)) {
                 continue;
             }
-            supplements_without_rich.add(dep.get());
-        }
-        if (supplements_without_rich.count() == 0) {
-            continue;
-        }
-        Query query(installed_query);
-        query.addFilter(HY_PKG_PROVIDES, &supplements_without_rich);
-        // When supplemented package already installed, exclude_from_weak available package
-        if (!query.empty()) {
-            add_exclude_from_weak(pkg);
+            auto cached = supplement_installed.find(dep);
+            if (cached == supplement_installed.end()) {
+                bool installed = false;
+                Id p, pp;
+                FOR_PROVIDES(p, pp, dep) {
+                    if (installed_pset->has(p)) {
+                        installed = true;
+                        break;
+                    }
+                }
+                cached = supplement_installed.emplace(dep, installed).first;
+            }
+            // When supplemented package already installed, exclude_from_weak available package
+            if (cached->second) {
+                excludes.set(available_id);
+                break;
+            }
         }
     }
+    map_free(&installed_names);
+
+    add_exclude_from_weak(excludes);
 }
 
 void
@@ -1446,11 +1495,21 @@ Solver *
 Goal::Impl::initSolver()
 {
     Pool *pool = dnf_sack_get_pool(sack);
-    Solver *solvNew = solver_create(pool);
 
-    if (solv)
+    /* libsolv supports solving again with the same solver, as long as
+     * the pool still has the layout the solver was created for */
+    if (solv && (solverNsolvables != pool->nsolvables || solv->installed != pool->installed)) {
         solver_free(solv);
-    solv = solvNew;
+        solv = nullptr;
+    }
+    if (!solv) {
+        solv = solver_create(pool);
+        solverNsolvables = pool->nsolvables;
+    }
+
+    /* flags of the previous run */
+    solver_set_flag(solv, SOLVER_FLAG_IGNORE_RECOMMENDED, 0);
+    solver_set_flag(solv, SOLVER_FLAG_ALLOW_DOWNGRADE, 0);
 
     /* vendor locking */
     int vendor = dnf_sack_get_allow_vendor_change(sack) ? 1 : 0;
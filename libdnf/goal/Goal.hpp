@@ -32,6 +32,8 @@
 
 namespace libdnf {
 
+class GoalSession;
+
 struct Goal {
 public:
     struct Error : public libdnf::Error {
@@ -80,6 +82,8 @@ public:
     void add_exclude_from_weak(DnfPackage *pkg);
     void reset_exclude_from_weak();
     void exclude_from_weak_autodetect();
+    /// Packages the solver must not pull in as weak dependencies
+    const PackageSet & get_exclude_from_weak() const noexcept;
     void disfavor(DnfPackage *new_pkg);
 
     /**
@@ -113,6 +117,12 @@ public:
 
     int jobLength();
 
+    /**
+    * @brief Drop all requests, protected packages and results, e.g. once the packages they refer
+    * to were replaced in the sack. The goal object stays valid.
+    */
+    void reset();
+
     /* resolving the goal */
     bool run(DnfGoalActions flags);
 
@@ -155,6 +165,7 @@ public:
     /// Concentrate all problems into a string
     static std::string formatAllProblemRules(const std::vector<std::vector<std::string>> & problems);
 private:
+    friend GoalSession;
     friend Query;
     class Impl;
     std::unique_ptr<Impl> pImpl;
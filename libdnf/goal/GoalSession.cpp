@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "GoalSession.hpp"
+#include "Goal-private.hpp"
+#include "../dnf-sack-private.hpp"
+
+extern "C" {
+#include <solv/transaction.h>
+}
+
+namespace libdnf {
+
+GoalSession::GoalSession(DnfSack * sack) : sack(sack) {}
+
+GoalSession::~GoalSession()
+{
+    for (auto solv : spareSolvers)
+        solver_free(solv);
+}
+
+bool
+GoalSession::run(Goal & goal, DnfGoalActions flags)
+{
+    auto & impl = *goal.pImpl;
+    Pool * pool = dnf_sack_get_pool(sack);
+
+    if (!impl.solv && !spareSolvers.empty()) {
+        impl.solv = spareSolvers.back();
+        impl.solverNsolvables = pool->nsolvables;
+        spareSolvers.pop_back();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool problems = goal.run(flags);
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    runStats.push_back({goal.jobLength(), problems, duration});
+    return problems;
+}
+
+void
+GoalSession::recycle(Goal & goal)
+{
+    auto & impl = *goal.pImpl;
+    Pool * pool = dnf_sack_get_pool(sack);
+
+    if (impl.trans) {
+        transaction_free(impl.trans);
+        impl.trans = nullptr;
+    }
+    if (!impl.solv)
+        return;
+    // a solver of another pool layout can't be reused
+    if (impl.solverNsolvables == pool->nsolvables && impl.solv->installed == pool->installed)
+        spareSolvers.push_back(impl.solv);
+    else
+        solver_free(impl.solv);
+    impl.solv = nullptr;
+}
+
+std::chrono::microseconds
+GoalSession::getTotalDuration() const
+{
+    std::chrono::microseconds total{0};
+    for (const auto & stats : runStats)
+        total += stats.duration;
+    return total;
+}
+
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOAL_SESSION_HPP
+#define __GOAL_SESSION_HPP
+
+#include <chrono>
+#include <vector>
+
+#include <solv/solver.h>
+
+#include "Goal.hpp"
+
+namespace libdnf {
+
+/**
+* @brief Solves many goals against one sack, e.g. to evaluate hypothetical transactions.
+*
+* Solvers given back with recycle() are handed to the next goal run through the session
+* instead of creating a new one, and the time of every run is recorded. libsolv generates the
+* rules from scratch for every solve, so this only saves the solver_create() of each run.
+*
+* The sack must not change while the session is in use.
+*/
+class GoalSession {
+public:
+    struct RunStats {
+        int jobLength;
+        bool problems;
+        std::chrono::microseconds duration;
+    };
+
+    explicit GoalSession(DnfSack * sack);
+    ~GoalSession();
+    GoalSession(const GoalSession &) = delete;
+    GoalSession & operator=(const GoalSession &) = delete;
+
+    /**
+    * @brief Resolve the goal, same as goal.run(flags)
+    *
+    * @return true when the goal has problems
+    */
+    bool run(Goal & goal, DnfGoalActions flags);
+
+    /**
+    * @brief Take the solver of a goal whose results are no longer needed
+    *
+    * The goal can still be run again but its results and problems are gone.
+    */
+    void recycle(Goal & goal);
+
+    const std::vector<RunStats> & getRunStats() const noexcept { return runStats; }
+    std::chrono::microseconds getTotalDuration() const;
+    void clearRunStats() { runStats.clear(); }
+
+private:
+    DnfSack * sack;
+    std::vector<Solver *> spareSolvers;
+    std::vector<RunStats> runStats;
+};
+
+}
+
+#endif /* __GOAL_SESSION_HPP */
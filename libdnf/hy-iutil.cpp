@@ -37,6 +37,10 @@
 #include <sys/utsname.h>
 #include <wordexp.h>
 
+// rpm
+#include <rpm/rpmdb.h>
+#include <rpm/rpmts.h>
+
 // libsolv
 extern "C" {
 #include <solv/chksum.h>
@@ -164,6 +168,30 @@ checksum_stat(unsigned char *out, FILE *fp)
     return 0;
 }
 
+/* checksum of the rpmdb cookie, changes whenever a package is added or removed */
+int
+checksum_rpmdb(unsigned char *out, const char *rootdir)
+{
+    rpmts ts = rpmtsCreate();
+    if (rootdir)
+        rpmtsSetRootDir(ts, rootdir);
+    if (rpmtsOpenDB(ts, O_RDONLY)) {
+        rpmtsFree(ts);
+        return 1;
+    }
+    char *cookie = rpmdbCookie(rpmtsGetRdb(ts));
+    rpmtsFree(ts);
+    if (!cookie)
+        return 1;
+
+    auto h = solv_chksum_create(CHKSUM_TYPE);
+    solv_chksum_add(h, CHKSUM_IDENT, strlen(CHKSUM_IDENT));
+    solv_chksum_add(h, cookie, strlen(cookie));
+    solv_chksum_free(h, out);
+    free(cookie);
+    return 0;
+}
+
 static std::array<char, solv_userdata_solv_toolversion_size>
 get_padded_solv_toolversion()
 {
@@ -46,7 +46,6 @@
 #include "hy-package-private.hpp"
 #include "hy-repo-private.hpp"
 #include "repo/solvable/DependencyContainer.hpp"
-#include "sack/advisorymodule.hpp"
 
 #define BLOCK_SIZE 31
 
@@ -1042,67 +1041,15 @@ dnf_package_get_changelogs(DnfPackage *pkg)
 GPtrArray *
 dnf_package_get_advisories(DnfPackage *pkg, int cmp_type)
 {
-    Dataiterator di;
-    Id evr;
-    int cmp;
-    Pool *pool = dnf_package_get_pool(pkg);
     DnfSack *sack = dnf_package_get_sack(pkg);
     GPtrArray *advisorylist = g_ptr_array_new_with_free_func((GDestroyNotify) dnf_advisory_free);
-    Solvable *s = get_solvable(pkg);
-
-    dataiterator_init(&di, pool, 0, 0, UPDATE_COLLECTION_NAME,
-                      pool_id2str(pool, s->name), SEARCH_STRING);
-    dataiterator_prepend_keyname(&di, UPDATE_COLLECTION);
-    dataiterator_prepend_keyname(&di, UPDATE_COLLECTIONLIST);
-    while (dataiterator_step(&di)) {
-        dataiterator_setpos_parent(&di);
-        if (pool_lookup_id(pool, SOLVID_POS, UPDATE_COLLECTION_ARCH) != s->arch)
-            continue;
-        evr = pool_lookup_id(pool, SOLVID_POS, UPDATE_COLLECTION_EVR);
-        if (!evr)
-            continue;
+    libdnf::AdvisoryIndex::ApplicabilityCache applicable;
+    std::vector<Id> advisories;
 
-        cmp = pool_evrcmp(pool, evr, s->evr, EVRCMP_COMPARE);
-        if ((cmp > 0 && (cmp_type & HY_GT)) ||
-            (cmp < 0 && (cmp_type & HY_LT)) ||
-            (cmp == 0 && (cmp_type & HY_EQ))) {
-
-            // We need to move the di dataiterator to the start of the advisory collection
-            // so that di_advisory_collection can be initialized with SOLVID_POS because
-            // the collection it self doesn't have an id.
-            dataiterator_seek(&di, DI_SEEK_PARENT);
-            dataiterator_setpos_parent(&di);
-            dataiterator_seek(&di, DI_SEEK_PARENT);
-
-            bool isModuleCollectionApplicable = true;
-            Dataiterator di_advisory_collection;
-            dataiterator_init(&di_advisory_collection, pool, 0, SOLVID_POS, UPDATE_MODULE, 0, 0);
-            while (dataiterator_step(&di_advisory_collection)) {
-                dataiterator_setpos(&di_advisory_collection);
-                Id name = pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_NAME);
-                Id stream = pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_STREAM);
-                Id version = pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_VERSION);
-                Id context = pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_CONTEXT);
-                Id arch = pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_ARCH);
-
-                libdnf::AdvisoryModule moduleAdvisory(sack, di.solvid, name, stream, version, context, arch);
-                if (moduleAdvisory.isApplicable()) {
-                    isModuleCollectionApplicable = true;
-                    break;
-                } else {
-                    isModuleCollectionApplicable = false;
-                }
-            }
-            dataiterator_free(&di_advisory_collection);
-
-            if (isModuleCollectionApplicable) {
-                g_ptr_array_add(advisorylist, dnf_advisory_new(sack, di.solvid));
-            }
-
-            dataiterator_skip_solvable(&di);
-        }
-    }
-    dataiterator_free(&di);
+    dnf_sack_get_advisory_index(sack)->getAdvisories(get_solvable(pkg), cmp_type, advisories,
+                                                     applicable);
+    for (auto advisory : advisories)
+        g_ptr_array_add(advisorylist, dnf_advisory_new(sack, advisory));
     return advisorylist;
 }
 
@@ -32,6 +32,7 @@
  */
 
 
+#include "dnf-advisory-private.hpp"
 #include "dnf-sack-private.hpp"
 #include "sack/packageset.hpp"
 
@@ -149,6 +150,42 @@ dnf_packageset_has(DnfPackageSet *pset, DnfPackage *pkg)
     return pset->has(pkg);
 }
 
+/**
+ * dnf_packageset_get_advisories:
+ * @pset: a #DnfPackageSet instance.
+ * @cmp_type: how the advisory package version compares to the package, e.g. %HY_GT
+ *
+ * Gets the advisories of all packages in the set at once, as
+ * dnf_package_get_advisories() would for each of them. Module states are
+ * evaluated once per advisory collection for the whole set.
+ *
+ * Returns: (transfer container) (element-type GPtrArray): one list of
+ * #DnfAdvisory per package of the set, in increasing package id order
+ *
+ * Since: 0.74.0
+ */
+GPtrArray *
+dnf_packageset_get_advisories(DnfPackageSet *pset, int cmp_type)
+{
+    DnfSack *sack = pset->getSack();
+    Pool *pool = dnf_sack_get_pool(sack);
+    auto advisoryIndex = dnf_sack_get_advisory_index(sack);
+    libdnf::AdvisoryIndex::ApplicabilityCache applicable;
+    std::vector<Id> advisories;
+    GPtrArray *perPackage = g_ptr_array_new_full(pset->size(), (GDestroyNotify) g_ptr_array_unref);
+
+    Id id = -1;
+    while ((id = pset->next(id)) != -1) {
+        advisoryIndex->getAdvisories(pool_id2solvable(pool, id), cmp_type, advisories, applicable);
+        GPtrArray *advisorylist = g_ptr_array_new_full(advisories.size(),
+                                                       (GDestroyNotify) dnf_advisory_free);
+        for (auto advisory : advisories)
+            g_ptr_array_add(advisorylist, dnf_advisory_new(sack, advisory));
+        g_ptr_array_add(perPackage, advisorylist);
+    }
+    return perPackage;
+}
+
 void
 dnf_packageset_free(DnfPackageSet *pset)
 {
@@ -23,6 +23,9 @@
 
 #include "hy-util.h"
 #include <glib.h>
+#include <solv/bitmap.h>
+#include <stdint.h>
+#include <string.h>
 
 gboolean hy_is_glob_pattern(const char *pattern);
 
@@ -37,24 +40,29 @@ static inline gboolean hy_is_file_pattern(const char *pattern)
     return pattern[0] == '/' || (pattern[0] == '*' && pattern[1] == '/');
 }
 
-// see http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetTable
-static const unsigned char _BitCountLookup[256] =
+/**
+ * @brief Load the 64 bits of a Map starting at byte offset, bit n of the word being the map
+ * bit offset * 8 + n. Bytes past the end of the map read as zero.
+ */
+inline uint64_t
+map_load_word(const Map *m, size_t offset)
 {
-#   define B2(n) n,     n+1,     n+1,     n+2
-#   define B4(n) B2(n), B2(n+1), B2(n+1), B2(n+2)
-#   define B6(n) B4(n), B4(n+1), B4(n+1), B4(n+2)
-    B6(0), B6(1), B6(1), B6(2)
-};
+    uint64_t word = 0;
+    size_t len = m->size - offset < sizeof(word) ? m->size - offset : sizeof(word);
+    memcpy(&word, m->map + offset, len);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
 
 inline size_t
 map_count(Map *m)
 {
-    unsigned char *ti = m->map;
-    unsigned char *end = ti + m->size;
-    unsigned c = 0;
+    size_t c = 0;
 
-    while (ti < end)
-        c += _BitCountLookup[*ti++];
+    for (size_t offset = 0; offset < static_cast<size_t>(m->size); offset += sizeof(uint64_t))
+        c += __builtin_popcountll(map_load_word(m, offset));
 
     return c;
 }
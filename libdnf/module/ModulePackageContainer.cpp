@@ -19,8 +19,10 @@
  */
 
 #include <algorithm>
+#include <fnmatch.h>
 #include <set>
 #include <sstream>
+#include <unordered_map>
 
 extern "C" {
 #include <solv/poolarch.h>
@@ -32,6 +34,7 @@ extern "C" {
 #include "libdnf/utils/utils.hpp"
 #include "libdnf/utils/File.hpp"
 #include "libdnf/dnf-sack-private.hpp"
+#include "libdnf/hy-iutil-private.hpp"
 #include "libdnf/hy-query.h"
 #include "libdnf/hy-types.h"
 #include <functional>
@@ -40,7 +43,7 @@ extern "C" {
 #include "libdnf/conf/ConfigParser.hpp"
 #include "libdnf/conf/OptionStringList.hpp"
 #include "libdnf/goal/Goal.hpp"
-#include "libdnf/repo/Repo-private.hpp"
+#include "libdnf/hy-repo-private.hpp"
 #include "libdnf/sack/selector.hpp"
 #include "libdnf/conf/Const.hpp"
 
@@ -191,6 +194,7 @@ public:
     std::vector<ModulePackage *> getLatestActiveEnabledModules();
     /// Required to call after all modules v3 are in metadata
     void addVersion2Modules();
+    void addRepoModules(ModulemdModuleIndex * index, const std::string & repoID);
 
 private:
     friend struct ModulePackageContainer;
@@ -215,6 +219,27 @@ private:
     std::vector<std::tuple<LibsolvRepo *, ModulemdModuleStream *, std::string>> modulesV2;
 
     bool isEnabled(const std::string &name, const std::string &stream);
+
+    /// Strings of a module solvable matched by the NSVCA query()
+    struct ModuleIndexEntry {
+        ModulePackage * module;
+        /// solvable.description = <moduleName>:<moduleStream>
+        std::string nameStream;
+        /// solvable.summary = <moduleContext>
+        std::string context;
+        std::string version;
+        std::string arch;
+    };
+    /// Available modules in increasing Id order, rebuilt by updateModuleIndex() once modules grow
+    std::vector<ModuleIndexEntry> moduleIndex;
+    std::unordered_map<std::string, std::vector<std::size_t>> moduleIndexByName;
+    std::unordered_map<std::string, std::vector<std::size_t>> moduleIndexByNameStream;
+    std::size_t moduleIndexSize{0};
+
+    void updateModuleIndex();
+    std::vector<ModulePackage *> queryModuleIndex(const std::string & name,
+        const std::string & stream, const std::string & version, const std::string & context,
+        const std::string & arch);
 };
 
 class ModulePackageContainer::Impl::ModulePersistor {
@@ -330,10 +355,12 @@ ModulePackageContainer::add(DnfSack * sack)
         }
         std::string yamlContent = getFileContent(modules_fn);
         auto repoName = hyRepo->getId();
-        add(yamlContent, repoName);
+        // parse the metadata once, the index feeds both the modules and the defaults
+        g_autoptr(ModulemdModuleIndex) index = ModuleMetadata::parseMetadata(yamlContent);
+        pImpl->addRepoModules(index, repoName);
         // update defaults from repo
         try {
-            pImpl->moduleMetadata.addMetadataFromString(yamlContent, 0);
+            pImpl->moduleMetadata.addMetadataFromIndex(index, 0);
         } catch (const ModulePackageContainer::ResolveException & exception) {
             throw ModulePackageContainer::ConflictException(
                 tfm::format(_("Conflicting defaults with repo '%s': %s"), repoName,
@@ -362,10 +389,17 @@ void ModulePackageContainer::moduleDefaultsResolve()
 void
 ModulePackageContainer::add(const std::string &fileContent, const std::string & repoID)
 {
-    Pool * pool = dnf_sack_get_pool(pImpl->moduleSack);
+    g_autoptr(ModulemdModuleIndex) index = ModuleMetadata::parseMetadata(fileContent);
+    pImpl->addRepoModules(index, repoID);
+}
+
+void
+ModulePackageContainer::Impl::addRepoModules(ModulemdModuleIndex * index, const std::string & repoID)
+{
+    Pool * pool = dnf_sack_get_pool(moduleSack);
 
     ModuleMetadata md;
-    md.addMetadataFromString(fileContent, 0);
+    md.addMetadataFromIndex(index, 0);
     md.resolveAddedMetadata();
 
     LibsolvRepo * repo = nullptr;
@@ -381,7 +415,7 @@ ModulePackageContainer::add(const std::string &fileContent, const std::string &
 
     // If not created yet, create it
     if (!repo) {
-        Pool * pool = dnf_sack_get_pool(pImpl->moduleSack);
+        Pool * pool = dnf_sack_get_pool(moduleSack);
         HyRepo hrepo = hy_repo_create(repoID.c_str());
         auto repoImpl = libdnf::repoGetImpl(hrepo);
         repo = repo_create(pool, repoID.c_str());
@@ -391,12 +425,12 @@ ModulePackageContainer::add(const std::string &fileContent, const std::string &
     }
 
     // add all modules to repository and pass ownership to module container
-    g_autofree gchar * path = g_build_filename(pImpl->installRoot.c_str(), "/etc/dnf/modules.d", NULL);
-    auto packages = md.getAllModulePackages(pImpl->moduleSack, repo, repoID, pImpl->modulesV2);
+    g_autofree gchar * path = g_build_filename(installRoot.c_str(), "/etc/dnf/modules.d", NULL);
+    auto packages = md.getAllModulePackages(moduleSack, repo, repoID, modulesV2);
     for(auto const& modulePackagePtr: packages) {
         std::unique_ptr<ModulePackage> modulePackage(modulePackagePtr);
-        pImpl->modules.insert(std::make_pair(modulePackage->getId(), std::move(modulePackage)));
-        pImpl->persistor->insert(modulePackagePtr->getName(), path);
+        modules.insert(std::make_pair(modulePackage->getId(), std::move(modulePackage)));
+        persistor->insert(modulePackagePtr->getName(), path);
     }
 }
 
@@ -776,31 +810,8 @@ ModulePackageContainer::query(std::string name, std::string stream, std::string
     std::string context, std::string arch)
 {
     pImpl->addVersion2Modules();
-    // Alternatively a search using module provides could be performed
-    std::vector<ModulePackage *> result;
-    Query query(pImpl->moduleSack, Query::ExcludeFlags::IGNORE_EXCLUDES);
-    // platform modules are installed and not in modules std::Map.
-    query.available();
-    if (!name.empty() || !stream.empty()) {
-        std::ostringstream ss;
-        ss << stringFormater(name) << ":" << stringFormater(stream);
-        query.addFilter(HY_PKG_DESCRIPTION, HY_GLOB, ss.str().c_str());
-    }
-    if (!context.empty()) {
-        query.addFilter(HY_PKG_SUMMARY, HY_GLOB, context.c_str());
-    }
-    if (!arch.empty()) {
-        query.addFilter(HY_PKG_ARCH, HY_GLOB, arch.c_str());
-    }
-    if (!version.empty()) {
-        query.addFilter(HY_PKG_VERSION, HY_GLOB, version.c_str());
-    }
-    auto pset = query.runSet();
-    Id moduleId = -1;
-    while ((moduleId = pset->next(moduleId)) != -1) {
-        result.push_back(pImpl->modules.at(moduleId).get());
-    }
-    return result;
+    pImpl->updateModuleIndex();
+    return pImpl->queryModuleIndex(name, stream, version, context, arch);
 }
 
 void ModulePackageContainer::enableDependencyTree(std::vector<ModulePackage *> & modulePackages)
@@ -1744,6 +1755,112 @@ std::vector<ModulePackage *> ModulePackageContainer::Impl::getLatestActiveEnable
     return activeModules;
 }
 
+static bool
+isGlobPattern(const std::string & pattern)
+{
+    return pattern.find_first_of("*?[\\") != std::string::npos;
+}
+
+/// Empty patterns match everything, like a missing filter
+static bool
+globMatches(const std::string & pattern, const std::string & value)
+{
+    if (pattern.empty())
+        return true;
+    if (!isGlobPattern(pattern))
+        return pattern == value;
+    return fnmatch(pattern.c_str(), value.c_str(), 0) == 0;
+}
+
+void ModulePackageContainer::Impl::updateModuleIndex()
+{
+    if (moduleIndexSize == modules.size()) {
+        return;
+    }
+    moduleIndex.clear();
+    moduleIndexByName.clear();
+    moduleIndexByNameStream.clear();
+
+    Pool * pool = dnf_sack_get_pool(moduleSack);
+    // new module solvables keep their strings in not yet internalized repodata
+    repo_internalize_all_trigger(pool);
+    for (auto const & module_pair : modules) {
+        Solvable * solvable = pool_id2solvable(pool, module_pair.first);
+        // platform modules are installed and not in modules std::Map, query() ignores the rest
+        if (pool->installed && solvable->repo == pool->installed) {
+            continue;
+        }
+        auto description = solvable_lookup_str(solvable, SOLVABLE_DESCRIPTION);
+        auto summary = solvable_lookup_str(solvable, SOLVABLE_SUMMARY);
+        char *e, *v, *r;
+        pool_split_evr(pool, pool_id2str(pool, solvable->evr), &e, &v, &r);
+        ModuleIndexEntry entry{module_pair.second.get(), description ? description : "",
+            summary ? summary : "", solvable->evr == ID_EMPTY ? "" : v,
+            pool_id2str(pool, solvable->arch)};
+
+        auto index = moduleIndex.size();
+        moduleIndexByNameStream[entry.nameStream].push_back(index);
+        moduleIndexByName[entry.nameStream.substr(0, entry.nameStream.find(':'))].push_back(index);
+        moduleIndex.push_back(std::move(entry));
+    }
+    moduleIndexSize = modules.size();
+}
+
+/**
+ * @brief Returns modules matching the NSVCA globs, an empty string matches any value.
+ *
+ * A literal name, or a literal name and stream, is answered from the hash tables, only glob name
+ * and stream patterns fall back to going through every module.
+ */
+std::vector<ModulePackage *>
+ModulePackageContainer::Impl::queryModuleIndex(const std::string & name, const std::string & stream,
+    const std::string & version, const std::string & context, const std::string & arch)
+{
+    std::vector<ModulePackage *> result;
+    auto matchesVCA = [&](const ModuleIndexEntry & entry) {
+        return globMatches(context, entry.context) && globMatches(arch, entry.arch)
+            && globMatches(version, entry.version);
+    };
+
+    const std::vector<std::size_t> * candidates = nullptr;
+    if (!name.empty() && !isGlobPattern(name)) {
+        if (stream.empty()) {
+            auto it = moduleIndexByName.find(name);
+            if (it == moduleIndexByName.end()) {
+                return result;
+            }
+            candidates = &it->second;
+        } else if (!isGlobPattern(stream)) {
+            auto it = moduleIndexByNameStream.find(name + ":" + stream);
+            if (it == moduleIndexByNameStream.end()) {
+                return result;
+            }
+            candidates = &it->second;
+        }
+    }
+
+    if (candidates) {
+        for (auto index : *candidates) {
+            auto & entry = moduleIndex[index];
+            if (matchesVCA(entry)) {
+                result.push_back(entry.module);
+            }
+        }
+        return result;
+    }
+
+    std::string nameStream;
+    if (!name.empty() || !stream.empty()) {
+        nameStream = stringFormater(name) + ":" + stringFormater(stream);
+    }
+    for (auto & entry : moduleIndex) {
+        if (globMatches(nameStream, entry.nameStream) && matchesVCA(entry)) {
+            result.push_back(entry.module);
+        }
+    }
+    return result;
+}
+
 void ModulePackageContainer::Impl::addVersion2Modules()
 {
     if (modulesV2.empty()) {
@@ -72,7 +72,7 @@ ModuleMetadata::~ModuleMetadata()
     }
 }
 
-void ModuleMetadata::addMetadataFromString(const std::string & yaml, int priority)
+ModulemdModuleIndex * ModuleMetadata::parseMetadata(const std::string & yaml)
 {
     GError *error = NULL;
     g_autoptr(GPtrArray) failures = NULL;
@@ -82,9 +82,22 @@ void ModuleMetadata::addMetadataFromString(const std::string & yaml, int priorit
     if(!success){
         ModuleMetadata::reportFailures(failures);
     }
-    if (error)
+    if (error) {
+        g_object_unref(mi);
         throw ModulePackageContainer::ResolveException( tfm::format(_("Failed to update from string: %s"), error->message));
+    }
+    return mi;
+}
+
+void ModuleMetadata::addMetadataFromString(const std::string & yaml, int priority)
+{
+    ModulemdModuleIndex * mi = parseMetadata(yaml);
+    addMetadataFromIndex(mi, priority);
+    g_object_unref(mi);
+}
 
+void ModuleMetadata::addMetadataFromIndex(ModulemdModuleIndex * index, int priority)
+{
     if (!moduleMerger){
         moduleMerger = modulemd_module_index_merger_new();
         if (resultingModuleIndex){
@@ -94,8 +107,8 @@ void ModuleMetadata::addMetadataFromString(const std::string & yaml, int priorit
         }
     }
 
-    modulemd_module_index_merger_associate_index(moduleMerger, mi, priority);
-    g_object_unref(mi);
+    // the merger only reads the index, it can be shared with other mergers
+    modulemd_module_index_merger_associate_index(moduleMerger, index, priority);
 }
 
 void ModuleMetadata::resolveAddedMetadata()
@@ -34,7 +34,10 @@ public:
     ModuleMetadata(const ModuleMetadata & m);
     ModuleMetadata & operator=(const ModuleMetadata & m);
     ~ModuleMetadata();
+    /// Parse the yaml once so that the index can be added to several ModuleMetadata
+    static ModulemdModuleIndex * parseMetadata(const std::string & yaml);
     void addMetadataFromString(const std::string & yaml, int priority);
+    void addMetadataFromIndex(ModulemdModuleIndex * index, int priority);
     void resolveAddedMetadata();
     std::vector<ModulePackage *> getAllModulePackages(DnfSack * moduleSack, LibsolvRepo * repo, const std::string & repoID, std::vector<std::tuple<LibsolvRepo *, ModulemdModuleStream *, std::string>> & modulesV2);
     std::map<std::string, std::string> getDefaultStreams();
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include <solv/evr.h>
+#include <solv/repo.h>
+
+#include "advisory.hpp"
+#include "advisoryindex.hpp"
+#include "advisorymodule.hpp"
+#include "../dnf-sack-private.hpp"
+#include "../hy-types.h"
+
+namespace libdnf {
+
+static bool
+entryLess(const AdvisoryIndex::Entry & first, const AdvisoryIndex::Entry & second)
+{
+    if (first.name != second.name)
+        return first.name < second.name;
+    if (first.arch != second.arch)
+        return first.arch < second.arch;
+    if (first.evr != second.evr)
+        return first.evr < second.evr;
+    return first.advisory < second.advisory;
+}
+
+static bool
+entryNameArchLess(const AdvisoryIndex::Entry & entry, const std::pair<Id, Id> & nameArch)
+{
+    if (entry.name != nameArch.first)
+        return entry.name < nameArch.first;
+    return entry.arch < nameArch.second;
+}
+
+AdvisoryIndex::AdvisoryIndex(DnfSack * sack) : sack(sack)
+{
+    Pool *pool = dnf_sack_get_pool(sack);
+    Dataiterator di;
+    Dataiterator di_list;
+    Dataiterator di_inner;
+
+    nsolvables = pool->nsolvables;
+    nrepos = pool->nrepos;
+
+    dataiterator_init(&di, pool, 0, 0, 0, 0, 0);
+    dataiterator_prepend_keyname(&di, UPDATE_COLLECTION);
+    while (dataiterator_step(&di)) {
+        Id advisory = di.solvid;
+        Advisory adv(sack, advisory);
+
+        addKey(Key::NAME, adv.getName(), advisory);
+        addKey(Key::TYPE, pool_lookup_str(pool, advisory, SOLVABLE_PATCHCATEGORY), advisory);
+        addKey(Key::SEVERITY, adv.getSeverity(), advisory);
+
+        dataiterator_init(&di_inner, pool, 0, advisory, UPDATE_REFERENCE, 0, 0);
+        while (dataiterator_step(&di_inner)) {
+            dataiterator_setpos(&di_inner);
+            const char *type = pool_lookup_str(pool, SOLVID_POS, UPDATE_REFERENCE_TYPE);
+            const char *id = pool_lookup_str(pool, SOLVID_POS, UPDATE_REFERENCE_ID);
+            if (!type)
+                continue;
+            if (strcmp(type, "bugzilla") == 0)
+                addKey(Key::BUG, id, advisory);
+            else if (strcmp(type, "cve") == 0)
+                addKey(Key::CVE, id, advisory);
+        }
+        dataiterator_free(&di_inner);
+
+        // the same walk as Advisory::getApplicablePackages(), keeping the module lists
+        dataiterator_init(&di_list, pool, 0, advisory, UPDATE_COLLECTIONLIST, 0, 0);
+        for (int position = 0; dataiterator_step(&di_list); ++position) {
+            dataiterator_setpos(&di_list);
+            Collection collection{advisory, position, {}};
+            dataiterator_init(&di_inner, pool, 0, SOLVID_POS, UPDATE_MODULE, 0, 0);
+            while (dataiterator_step(&di_inner)) {
+                dataiterator_setpos(&di_inner);
+                collection.modules.push_back({
+                    pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_NAME),
+                    pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_STREAM),
+                    pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_VERSION),
+                    pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_CONTEXT),
+                    pool_lookup_id(pool, SOLVID_POS, UPDATE_MODULE_ARCH)});
+            }
+            dataiterator_free(&di_inner);
+
+            dataiterator_setpos(&di_list);
+            int collectionIndex = collections.size();
+            dataiterator_init(&di_inner, pool, 0, SOLVID_POS, UPDATE_COLLECTION, 0, 0);
+            for (int pkgPosition = 0; dataiterator_step(&di_inner); ++pkgPosition) {
+                dataiterator_setpos(&di_inner);
+                entries.push_back({
+                    pool_lookup_id(pool, SOLVID_POS, UPDATE_COLLECTION_NAME),
+                    pool_lookup_id(pool, SOLVID_POS, UPDATE_COLLECTION_ARCH),
+                    pool_lookup_id(pool, SOLVID_POS, UPDATE_COLLECTION_EVR),
+                    advisory, collectionIndex, pkgPosition});
+            }
+            dataiterator_free(&di_inner);
+            collections.push_back(std::move(collection));
+        }
+        dataiterator_free(&di_list);
+
+        dataiterator_skip_solvable(&di);
+    }
+    dataiterator_free(&di);
+
+    std::sort(entries.begin(), entries.end(), entryLess);
+}
+
+void
+AdvisoryIndex::addKey(Key key, const char * value, Id advisory)
+{
+    if (value)
+        keys[static_cast<int>(key)][value].push_back(advisory);
+}
+
+void
+AdvisoryIndex::match(Key key, const char * value, Map * advisories) const
+{
+    auto & table = keys[static_cast<int>(key)];
+    auto found = table.find(value);
+    if (found == table.end())
+        return;
+    for (auto advisory : found->second)
+        MAPSET(advisories, advisory);
+}
+
+bool
+AdvisoryIndex::isApplicable(const Entry & entry) const
+{
+    auto & collection = collections[entry.collection];
+    if (collection.modules.empty())
+        return true;
+    for (auto & module : collection.modules) {
+        AdvisoryModule moduleAdvisory(sack, collection.advisory, module.name, module.stream,
+                                      module.version, module.context, module.arch);
+        if (moduleAdvisory.isApplicable())
+            return true;
+    }
+    return false;
+}
+
+void
+AdvisoryIndex::getFilenames(const Collection & collection,
+                            std::vector<const char *> & filenames) const
+{
+    Pool *pool = dnf_sack_get_pool(sack);
+    Dataiterator di;
+    Dataiterator di_inner;
+
+    filenames.clear();
+    dataiterator_init(&di, pool, 0, collection.advisory, UPDATE_COLLECTIONLIST, 0, 0);
+    for (int position = 0; dataiterator_step(&di); ++position) {
+        if (position != collection.position)
+            continue;
+        dataiterator_setpos(&di);
+        dataiterator_init(&di_inner, pool, 0, SOLVID_POS, UPDATE_COLLECTION, 0, 0);
+        while (dataiterator_step(&di_inner)) {
+            dataiterator_setpos(&di_inner);
+            filenames.push_back(pool_lookup_str(pool, SOLVID_POS, UPDATE_COLLECTION_FILENAME));
+        }
+        dataiterator_free(&di_inner);
+        break;
+    }
+    dataiterator_free(&di);
+}
+
+void
+AdvisoryIndex::getApplicablePackages(const Map * advisories, std::vector<AdvisoryPkg> & pkgs,
+                                     bool withFilenames) const
+{
+    // module states are evaluated once per collection and call
+    ApplicabilityCache applicable(collections.size(), -1);
+    std::unordered_map<int, std::vector<const char *>> filenames;
+
+    for (auto & entry : entries) {
+        if (advisories && !MAPTST(advisories, entry.advisory))
+            continue;
+        auto & state = applicable[entry.collection];
+        if (state < 0)
+            state = isApplicable(entry);
+        if (!state)
+            continue;
+        const char * filename = nullptr;
+        if (withFilenames) {
+            auto found = filenames.find(entry.collection);
+            if (found == filenames.end()) {
+                found = filenames.emplace(entry.collection, std::vector<const char *>()).first;
+                getFilenames(collections[entry.collection], found->second);
+            }
+            if (static_cast<size_t>(entry.position) < found->second.size())
+                filename = found->second[entry.position];
+        }
+        pkgs.emplace_back(sack, entry.advisory, entry.name, entry.evr, entry.arch, filename);
+    }
+}
+
+AdvisoryIndex::Range
+AdvisoryIndex::byNameArch(Id name, Id arch) const
+{
+    auto nameArch = std::make_pair(name, arch);
+    auto low = std::lower_bound(entries.begin(), entries.end(), nameArch, entryNameArchLess);
+    auto high = low;
+    while (high != entries.end() && high->name == name && high->arch == arch)
+        ++high;
+    return {low, high};
+}
+
+void
+AdvisoryIndex::getAdvisories(const Solvable * s, int cmpType, std::vector<Id> & advisories,
+                             ApplicabilityCache & applicable) const
+{
+    Pool *pool = dnf_sack_get_pool(sack);
+
+    advisories.clear();
+    applicable.resize(collections.size(), -1);
+    auto range = byNameArch(s->name, s->arch);
+    for (auto entry = range.first; entry != range.second; ++entry) {
+        if (!entry->evr)
+            continue;
+        int cmp = pool_evrcmp(pool, entry->evr, s->evr, EVRCMP_COMPARE);
+        if (!((cmp > 0 && (cmpType & HY_GT)) ||
+              (cmp < 0 && (cmpType & HY_LT)) ||
+              (cmp == 0 && (cmpType & HY_EQ))))
+            continue;
+        auto & state = applicable[entry->collection];
+        if (state < 0)
+            state = isApplicable(*entry);
+        if (state)
+            advisories.push_back(entry->advisory);
+    }
+    std::sort(advisories.begin(), advisories.end());
+    advisories.erase(std::unique(advisories.begin(), advisories.end()), advisories.end());
+}
+
+}
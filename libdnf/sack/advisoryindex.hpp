@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __ADVISORY_INDEX_HPP
+#define __ADVISORY_INDEX_HPP
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <solv/bitmap.h>
+#include <solv/pool.h>
+
+#include "../dnf-types.h"
+#include "advisorypkg.hpp"
+
+namespace libdnf {
+
+/**
+* @brief Advisories of the pool looked up by name, reference, type and severity, and the
+* packages they list sorted by (name, arch, evr).
+*
+* Whether a module collection of an advisory applies depends on the active modules, which can
+* change without touching the pool, so it is evaluated on every lookup and not stored.
+*/
+class AdvisoryIndex {
+public:
+    enum class Key { NAME, BUG, CVE, TYPE, SEVERITY };
+
+    struct Entry {
+        Id name;
+        Id arch;
+        Id evr;
+        Id advisory;
+        /// Index of the collection in the index's collection table
+        int collection;
+        /// Position of the package in its collection
+        int position;
+    };
+    typedef std::vector<Entry>::const_iterator const_iterator;
+    typedef std::pair<const_iterator, const_iterator> Range;
+
+    explicit AdvisoryIndex(DnfSack * sack);
+
+    /**
+    * @brief Sets the bits of the advisories whose key equals value in advisories
+    */
+    void match(Key key, const char * value, Map * advisories) const;
+
+    /**
+    * @brief Appends the packages of applicable collections to pkgs, sorted by (name, arch, evr)
+    *
+    * @param advisories Advisories to take packages from, nullptr for all of them
+    * @param withFilenames Look up the file names of the packages too
+    */
+    void getApplicablePackages(const Map * advisories, std::vector<AdvisoryPkg> & pkgs,
+                               bool withFilenames) const;
+
+    /**
+    * @brief Returns the packages named name with architecture arch, in increasing evr id order
+    */
+    Range byNameArch(Id name, Id arch) const;
+
+    /**
+    * @brief Returns true if the collection of entry has no module or an active one
+    */
+    bool isApplicable(const Entry & entry) const;
+
+    /**
+    * @brief Module state of every collection, evaluated on first use by getAdvisories()
+    *
+    * Valid as long as no module is enabled or disabled, keep one per batch of lookups.
+    */
+    typedef std::vector<signed char> ApplicabilityCache;
+
+    /**
+    * @brief Replaces the content of advisories with the advisories listing the package s under
+    * a version that compares to the version of s as cmpType (HY_GT, HY_LT, HY_EQ), each once and
+    * in increasing id order
+    */
+    void getAdvisories(const Solvable * s, int cmpType, std::vector<Id> & advisories,
+                       ApplicabilityCache & applicable) const;
+
+    /**
+    * @brief Returns false once solvables were added to the pool behind the index's back
+    */
+    bool isCurrent(const Pool * pool) const noexcept
+    { return pool->nsolvables == nsolvables && pool->nrepos == nrepos; }
+
+private:
+    struct ModuleKey {
+        Id name;
+        Id stream;
+        Id version;
+        Id context;
+        Id arch;
+    };
+    struct Collection {
+        Id advisory;
+        /// Position in the advisory's UPDATE_COLLECTIONLIST
+        int position;
+        std::vector<ModuleKey> modules;
+    };
+
+    DnfSack * sack;
+    std::vector<Entry> entries;
+    std::vector<Collection> collections;
+    std::unordered_map<std::string, std::vector<Id>> keys[5];
+    int nsolvables;
+    int nrepos;
+
+    void addKey(Key key, const char * value, Id advisory);
+    void getFilenames(const Collection & collection, std::vector<const char *> & filenames) const;
+};
+
+}
+
+#endif /* __ADVISORY_INDEX_HPP */
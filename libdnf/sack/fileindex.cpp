@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fnmatch.h>
+#include <unordered_map>
+
+#include <solv/dirpool.h>
+#include <solv/repo.h>
+#include <solv/repodata.h>
+
+#include "fileindex.hpp"
+#include "../hy-repo-private.hpp"
+
+namespace libdnf {
+
+namespace {
+
+/* FNV-1a, continued over the pieces of a path so that no path has to be composed */
+constexpr std::uint32_t FNV_OFFSET = 2166136261u;
+constexpr std::uint32_t FNV_PRIME = 16777619u;
+
+inline std::uint32_t
+hashChar(char c, std::uint32_t hash)
+{
+    return (hash ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+}
+
+inline std::uint32_t
+hashString(const char * str, std::uint32_t hash = FNV_OFFSET)
+{
+    for (; *str; ++str)
+        hash = hashChar(*str, hash);
+    return hash;
+}
+
+const char *
+dirComponent(Repodata * data, Id dir)
+{
+    Id comp = dirpool_compid(&data->dirpool, dir);
+    return data->localpool ? stringpool_id2str(&data->spool, comp) : pool_id2str(data->repo->pool, comp);
+}
+
+/* the dirpool joins the components of a directory with '/' like repodata_dir2str(), the root
+ * directory is an empty component */
+void
+dirPath(Repodata * data, Id dir, std::string & out)
+{
+    Id parent = dirpool_parent(&data->dirpool, dir);
+    if (parent) {
+        dirPath(data, parent, out);
+        out.push_back('/');
+    }
+    out.append(dirComponent(data, dir));
+}
+
+/* true when the first len bytes of path spell the directory */
+bool
+dirEquals(Repodata * data, Id dir, const char * path, std::size_t len)
+{
+    while (true) {
+        const char * comp = dirComponent(data, dir);
+        std::size_t compLen = strlen(comp);
+        Id parent = dirpool_parent(&data->dirpool, dir);
+        if (!parent)
+            return compLen == len && memcmp(path, comp, len) == 0;
+        if (len < compLen + 1 || path[len - compLen - 1] != '/' ||
+            memcmp(path + len - compLen, comp, compLen) != 0)
+            return false;
+        len -= compLen + 1;
+        dir = parent;
+    }
+}
+
+/// Path hashes of the directories of one repodata, computed on demand
+class DirHashes {
+public:
+    explicit DirHashes(Repodata * data)
+    : data(data), hashes(data->dirpool.ndirs), known(data->dirpool.ndirs, false) {}
+
+    std::uint32_t get(Id dir)
+    {
+        if (known[dir])
+            return hashes[dir];
+        Id parent = dirpool_parent(&data->dirpool, dir);
+        auto hash = hashString(dirComponent(data, dir), parent ? hashChar('/', get(parent)) : FNV_OFFSET);
+        hashes[dir] = hash;
+        known[dir] = true;
+        return hash;
+    }
+
+private:
+    Repodata * data;
+    std::vector<std::uint32_t> hashes;
+    std::vector<bool> known;
+};
+
+int
+countRepodata(Pool * pool)
+{
+    int count = 0;
+    Id repoid;
+    Repo * repo;
+    FOR_REPOS(repoid, repo)
+        count += repo->nrepodata;
+    return count;
+}
+
+/* a solvable only matches when it owns the path, the hash may collide */
+bool
+ownsPath(Pool * pool, Id solvid, const char * path, std::size_t dirLen)
+{
+    const char * basename = path + dirLen + 1;
+    bool found = false;
+    Dataiterator di;
+    dataiterator_init(&di, pool, 0, solvid, SOLVABLE_FILELIST, NULL, 0);
+    while (dataiterator_step(&di)) {
+        if (strcmp(di.kv.str, basename) == 0 && dirEquals(di.data, di.kv.id, path, dirLen)) {
+            found = true;
+            break;
+        }
+    }
+    dataiterator_free(&di);
+    return found;
+}
+
+}
+
+FileIndex::FileIndex(Pool * pool)
+: pool(pool), nsolvables(pool->nsolvables), nrepos(pool->nrepos)
+{
+    std::vector<std::pair<std::uint32_t, Id>> hashes;
+    std::unordered_map<Repodata *, DirHashes> dirHashes;
+    Repodata * lastData = nullptr;
+    DirHashes * dirs = nullptr;
+    Dataiterator di;
+
+    repo_internalize_all_trigger(pool);
+    // without SEARCH_FILES the iterator hands out dirpool ids and basenames, not joined paths
+    dataiterator_init(&di, pool, 0, 0, SOLVABLE_FILELIST, NULL, 0);
+    while (dataiterator_step(&di)) {
+        if (di.data != lastData) {
+            lastData = di.data;
+            dirs = &dirHashes.emplace(di.data, DirHashes(di.data)).first->second;
+        }
+        hashes.emplace_back(hashString(di.kv.str, hashChar('/', dirs->get(di.kv.id))), di.solvid);
+    }
+    dataiterator_free(&di);
+
+    // about two entries per bucket, counting sort them by bucket
+    int bits = 1;
+    while (bits < 31 && (std::size_t(1) << (bits + 1)) < hashes.size())
+        ++bits;
+    bucketShift = 32 - bits;
+    buckets.assign((std::size_t(1) << bits) + 1, 0);
+    for (const auto & entry : hashes)
+        ++buckets[(entry.first >> bucketShift) + 1];
+    for (std::size_t i = 1; i < buckets.size(); ++i)
+        buckets[i] += buckets[i - 1];
+    solvables.resize(hashes.size());
+    std::vector<std::uint32_t> fill(buckets.begin(), buckets.end() - 1);
+    for (const auto & entry : hashes)
+        solvables[fill[entry.first >> bucketShift]++] = entry.second;
+
+    nrepodata = countRepodata(pool);
+}
+
+bool
+FileIndex::isCurrent(const Pool * pool) const noexcept
+{
+    return pool->nsolvables == nsolvables && pool->nrepos == nrepos &&
+        countRepodata(const_cast<Pool *>(pool)) == nrepodata;
+}
+
+void
+FileIndex::match(const char * path, Map * m) const
+{
+    const char * slash = strrchr(path, '/');
+    if (!slash)
+        return;
+    std::size_t dirLen = slash - path;
+
+    auto bucket = hashString(path) >> bucketShift;
+    for (auto i = buckets[bucket]; i < buckets[bucket + 1]; ++i) {
+        Id solvid = solvables[i];
+        if (!MAPTST(m, solvid) && ownsPath(pool, solvid, path, dirLen))
+            MAPSET(m, solvid);
+    }
+}
+
+void
+FileIndex::matchGlob(Pool * pool, const char * pattern, Map * m)
+{
+    auto prefix = globPrefix(pattern);
+    // per repodata and directory: 0 not seen yet, 1 no path below it can match, 2 maybe
+    std::unordered_map<Repodata *, std::vector<char>> dirStates;
+    std::unordered_map<Repodata *, std::unordered_map<Id, std::string>> dirPaths;
+    std::string path;
+    Dataiterator di;
+
+    dataiterator_init(&di, pool, 0, 0, SOLVABLE_FILELIST, NULL, 0);
+    while (dataiterator_step(&di)) {
+        if (MAPTST(m, di.solvid)) {
+            dataiterator_skip_solvable(&di);
+            continue;
+        }
+        auto & states = dirStates[di.data];
+        if (states.empty())
+            states.resize(di.data->dirpool.ndirs, 0);
+        Id dir = di.kv.id;
+        if (states[dir] == 0) {
+            path.clear();
+            dirPath(di.data, dir, path);
+            path.push_back('/');
+            bool possible = prefix.size() <= path.size() ?
+                path.compare(0, prefix.size(), prefix) == 0 :
+                prefix.compare(0, path.size(), path) == 0;
+            states[dir] = possible ? 2 : 1;
+            if (possible)
+                dirPaths[di.data].emplace(dir, path);
+        }
+        if (states[dir] == 1)
+            continue;
+        path = dirPaths[di.data][dir];
+        path.append(di.kv.str);
+        if (path.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        if (fnmatch(pattern, path.c_str(), 0) == 0) {
+            MAPSET(m, di.solvid);
+            dataiterator_skip_solvable(&di);
+        }
+    }
+    dataiterator_free(&di);
+}
+
+std::string
+FileIndex::globPrefix(const char * pattern)
+{
+    return std::string(pattern, strcspn(pattern, "*?[\\"));
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __FILE_INDEX_HPP
+#define __FILE_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <solv/bitmap.h>
+#include <solv/pool.h>
+
+namespace libdnf {
+
+/**
+* @brief Path hash -> solvable table over the SOLVABLE_FILELIST data of every repo in the pool.
+*
+* Paths are not copied: the hashes are computed from libsolv's dirpool components and basenames
+* in a single dataiterator pass and bucketed by their top bits, every hit is checked against the
+* filelist of its solvable. Lookups step dataiterators, which page in filelists of repos loaded
+* from .solv caches, so they must not run on several threads at once.
+*/
+class FileIndex {
+public:
+    explicit FileIndex(Pool * pool);
+
+    /**
+    * @brief Set in m every solvable owning exactly the given path
+    */
+    void match(const char * path, Map * m) const;
+
+    /**
+    * @brief Set in m every solvable owning a path matching the fnmatch(3) pattern
+    *
+    * Needs no index: it walks the filelists once and only composes the paths below directories
+    * compatible with the literal prefix of the pattern.
+    */
+    static void matchGlob(Pool * pool, const char * pattern, Map * m);
+
+    std::size_t size() const noexcept { return solvables.size(); }
+
+    /**
+    * @brief Returns false once repos, repodata or solvables were added to the pool behind the
+    * index's back
+    */
+    bool isCurrent(const Pool * pool) const noexcept;
+
+    /**
+    * @brief Returns the literal part of a glob pattern preceding its first wildcard
+    */
+    static std::string globPrefix(const char * pattern);
+
+private:
+    Pool * pool;
+    /// Solvables of every filelist entry, ordered by the bucket of the entry's path hash
+    std::vector<Id> solvables;
+    /// Start of every bucket in solvables, plus the end
+    std::vector<std::uint32_t> buckets;
+    int bucketShift;
+    int nsolvables;
+    int nrepos;
+    int nrepodata;
+};
+
+}
+
+#endif /* __FILE_INDEX_HPP */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include <solv/evr.h>
+#include <solv/repo.h>
+#include <solv/util.h>
+
+#include "latestindex.hpp"
+#include "../hy-iutil-private.hpp"
+
+namespace libdnf {
+
+static int
+filter_latest_sortcmp(const void *ap, const void *bp, void *dp)
+{
+    auto pool = static_cast<Pool *>(dp);
+    Solvable *sa = pool->solvables + *(Id *)ap;
+    Solvable *sb = pool->solvables + *(Id *)bp;
+    int r;
+    r = sa->name - sb->name;
+    if (r)
+        return r;
+    r = pool_evrcmp(pool, sb->evr, sa->evr, EVRCMP_COMPARE);
+    if (r)
+        return r;
+    return *(Id *)ap - *(Id *)bp;
+}
+
+static int
+filter_latest_sortcmp_byarch(const void *ap, const void *bp, void *dp)
+{
+    auto pool = static_cast<Pool *>(dp);
+    Solvable *sa = pool->solvables + *(Id *)ap;
+    Solvable *sb = pool->solvables + *(Id *)bp;
+    int r;
+    r = sa->name - sb->name;
+    if (r)
+        return r;
+    r = sa->arch - sb->arch;
+    if (r)
+        return r;
+    r = pool_evrcmp(pool, sb->evr, sa->evr, EVRCMP_COMPARE);
+    if (r)
+        return r;
+    return *(Id *)ap - *(Id *)bp;
+}
+
+static int
+filter_latest_sortcmp_byarch_bypriority(const void *ap, const void *bp, void *dp)
+{
+    auto pool = static_cast<Pool *>(dp);
+    Solvable *sa = pool->solvables + *(Id *)ap;
+    Solvable *sb = pool->solvables + *(Id *)bp;
+    int r;
+    r = sa->name - sb->name;
+    if (r)
+        return r;
+    r = sa->arch - sb->arch;
+    if (r)
+        return r;
+    r = sb->repo->priority - sa->repo->priority;
+    if (r)
+        return r;
+    r = pool_evrcmp(pool, sb->evr, sa->evr, EVRCMP_COMPARE);
+    if (r)
+        return r;
+    return *(Id *)ap - *(Id *)bp;
+}
+
+/* below 1/8 of the pool sorting the subset by rank beats walking the whole ordering */
+#define WALK_RATIO 8
+/* below 1/32 of the pool the subset is sorted on its own while the ordering is not built yet */
+#define SORT_RATIO 32
+
+typedef int (*SortCmp)(const void *, const void *, void *);
+
+static SortCmp
+sortcmp(LatestIndex::Grouping grouping)
+{
+    switch (grouping) {
+        case LatestIndex::Grouping::NAME_ARCH:
+            return filter_latest_sortcmp_byarch;
+        case LatestIndex::Grouping::NAME_ARCH_PRIORITY:
+            return filter_latest_sortcmp_byarch_bypriority;
+        default:
+            return filter_latest_sortcmp;
+    }
+}
+
+LatestIndex::LatestIndex(Pool * pool) : pool(pool), nsolvables(pool->nsolvables)
+{
+    Repo *repo;
+    int i;
+
+    priorities.resize(pool->nrepos);
+    FOR_REPOS(i, repo)
+        priorities[i] = repo->priority;
+}
+
+bool
+LatestIndex::isCurrent(const Pool * pool) const noexcept
+{
+    Repo *repo;
+    int i;
+
+    if (pool->nsolvables != nsolvables || pool->nrepos != static_cast<int>(priorities.size()))
+        return false;
+    FOR_REPOS(i, repo) {
+        if (repo->priority != priorities[i])
+            return false;
+    }
+    return true;
+}
+
+LatestIndex::Ordering &
+LatestIndex::getOrdering(Grouping grouping)
+{
+    auto & ordering = orderings[static_cast<int>(grouping)];
+    if (ordering.built)
+        return ordering;
+
+    Id p;
+    FOR_PKG_SOLVABLES(p)
+        ordering.ids.push_back(p);
+    solv_sort(ordering.ids.data(), ordering.ids.size(), sizeof(Id), sortcmp(grouping), pool);
+    ordering.rank.assign(nsolvables, -1);
+    for (size_t pos = 0; pos < ordering.ids.size(); ++pos)
+        ordering.rank[ordering.ids[pos]] = pos;
+    ordering.built = true;
+    return ordering;
+}
+
+void
+LatestIndex::order(const PackageSet & pset, Grouping grouping, Queue * out)
+{
+    queue_empty(out);
+    if (!orderings[static_cast<int>(grouping)].built &&
+        pset.size() * SORT_RATIO < static_cast<size_t>(nsolvables)) {
+        Id id = -1;
+        while ((id = pset.next(id)) != -1)
+            queue_push(out, id);
+        solv_sort(out->elements, out->count, sizeof(Id), sortcmp(grouping), pool);
+        return;
+    }
+
+    auto & ordering = getOrdering(grouping);
+    if (pset.size() * WALK_RATIO >= ordering.ids.size()) {
+        for (auto id : ordering.ids) {
+            if (pset.has(id))
+                queue_push(out, id);
+        }
+        return;
+    }
+
+    Id id = -1;
+    while ((id = pset.next(id)) != -1) {
+        if (id < nsolvables && ordering.rank[id] >= 0)
+            queue_push(out, id);
+    }
+    auto & rank = ordering.rank;
+    std::sort(out->elements, out->elements + out->count,
+              [&rank](Id first, Id second) { return rank[first] < rank[second]; });
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __LATEST_INDEX_HPP
+#define __LATEST_INDEX_HPP
+
+#include <vector>
+
+#include <solv/pool.h>
+#include <solv/queue.h>
+
+#include "packageset.hpp"
+
+namespace libdnf {
+
+/**
+* @brief Package solvables of the pool presorted the way filterLatest() groups them.
+*
+* Every ordering puts the packages of one group next to each other, newest EVR first. Each
+* ordering is sorted with pool_evrcmp() once, on first use by a set large enough to pay for it;
+* afterwards any subset of the pool can be put in that order by integer comparisons or by a walk
+* over the ordering. Small sets are sorted on their own until then.
+*/
+class LatestIndex {
+public:
+    enum class Grouping {
+        NAME,                   ///< name, then EVR descending
+        NAME_ARCH,              ///< name, arch, then EVR descending
+        NAME_ARCH_PRIORITY      ///< name, arch, repo priority descending, then EVR descending
+    };
+
+    explicit LatestIndex(Pool * pool);
+
+    /**
+    * @brief Replaces the content of out with the packages of pset in the order of grouping
+    */
+    void order(const PackageSet & pset, Grouping grouping, Queue * out);
+
+    /**
+    * @brief Returns false once the pool's packages or repo priorities changed behind the index's
+    * back
+    */
+    bool isCurrent(const Pool * pool) const noexcept;
+
+private:
+    struct Ordering {
+        bool built{false};
+        std::vector<Id> ids;
+        /// Position of every solvable in ids, indexed by solvable id
+        std::vector<int> rank;
+    };
+
+    Pool * pool;
+    Ordering orderings[3];
+    std::vector<int> priorities;
+    int nsolvables;
+
+    Ordering & getOrdering(Grouping grouping);
+};
+
+}
+
+#endif /* __LATEST_INDEX_HPP */
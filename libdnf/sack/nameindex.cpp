@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include <solv/repo.h>
+
+#include "nameindex.hpp"
+#include "../hy-iutil-private.hpp"
+
+namespace libdnf {
+
+static bool
+nameIndexKeyLess(const std::pair<Id, Id> & entry, Id key)
+{
+    return entry.first < key;
+}
+
+static NameIndex::Range
+nameIndexRange(const std::vector<std::pair<Id, Id>> & entries, Id key)
+{
+    auto low = std::lower_bound(entries.begin(), entries.end(), key, nameIndexKeyLess);
+    auto high = low;
+    while (high != entries.end() && high->first == key)
+        ++high;
+    return {low, high};
+}
+
+NameIndex::NameIndex(Pool * pool) : pool(pool), nsolvables(pool->nsolvables), nrepos(pool->nrepos)
+{
+    Id p;
+    FOR_PKG_SOLVABLES(p) {
+        entries.emplace_back(pool_id2solvable(pool, p)->name, p);
+    }
+    std::sort(entries.begin(), entries.end());
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it == entries.begin() || (it - 1)->first != it->first)
+            names.push_back(*it);
+    }
+    std::sort(names.begin(), names.end(),
+        [](const std::pair<Id, Id> & first, const std::pair<Id, Id> & second)
+        { return first.second < second.second; });
+}
+
+NameIndex::Range
+NameIndex::byName(Id name) const
+{
+    return nameIndexRange(entries, name);
+}
+
+NameIndex::Range
+NameIndex::bySourceName(Id name)
+{
+    buildSources();
+    return nameIndexRange(sources, name);
+}
+
+const std::vector<Id> &
+NameIndex::getUnindexedSources()
+{
+    buildSources();
+    return unindexedSources;
+}
+
+void
+NameIndex::buildSources()
+{
+    if (sourcesBuilt)
+        return;
+    for (const auto & entry : entries) {
+        Solvable *s = pool_id2solvable(pool, entry.second);
+        const char *sourceName = solvable_lookup_str(s, SOLVABLE_SOURCENAME);
+        Id sourceId = sourceName ? pool_str2id(pool, sourceName, 0) : s->name;
+        if (sourceId)
+            sources.emplace_back(sourceId, entry.second);
+        else
+            unindexedSources.push_back(entry.second);
+    }
+    std::sort(sources.begin(), sources.end());
+    sourcesBuilt = true;
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __NAME_INDEX_HPP
+#define __NAME_INDEX_HPP
+
+#include <utility>
+#include <vector>
+
+#include <solv/pool.h>
+
+namespace libdnf {
+
+/**
+* @brief Package solvables of the pool grouped by name and by source package name.
+*
+* The name part is built in one pass over the pool; the source name part, which needs a
+* repodata lookup per package, only on first use.
+*/
+class NameIndex {
+public:
+    typedef std::vector<std::pair<Id, Id>>::const_iterator const_iterator;
+    typedef std::pair<const_iterator, const_iterator> Range;
+
+    explicit NameIndex(Pool * pool);
+
+    /**
+    * @brief Returns packages named name as (name, solvable) pairs in increasing solvable order
+    */
+    Range byName(Id name) const;
+
+    /**
+    * @brief Returns packages built from the source package named name
+    */
+    Range bySourceName(Id name);
+
+    /**
+    * @brief Packages whose source name is not in the pool string space, bySourceName() can not
+    * find them
+    */
+    const std::vector<Id> & getUnindexedSources();
+
+    /**
+    * @brief Every distinct package name as (name, first solvable) in increasing solvable order
+    */
+    const std::vector<std::pair<Id, Id>> & getNames() const noexcept { return names; }
+
+    /**
+    * @brief Returns false once repos or solvables were added to the pool behind the index's back
+    */
+    bool isCurrent(const Pool * pool) const noexcept
+    { return pool->nsolvables == nsolvables && pool->nrepos == nrepos; }
+
+private:
+    Pool * pool;
+    std::vector<std::pair<Id, Id>> entries;
+    std::vector<std::pair<Id, Id>> names;
+    bool sourcesBuilt{false};
+    std::vector<std::pair<Id, Id>> sources;
+    std::vector<Id> unindexedSources;
+    int nsolvables;
+    int nrepos;
+
+    void buildSources();
+};
+
+}
+
+#endif /* __NAME_INDEX_HPP */
@@ -18,7 +18,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <vector>
 
 #include "packageset.hpp"
 #include "../dnf-sack.h"
@@ -26,6 +31,25 @@
 
 namespace libdnf {
 
+/* a sparse set is kept while its ids take at most a quarter of the bytes of the bitmap */
+#define SPARSE_RATIO 32
+
+/* one rank entry per 512 bits keeps the index at 1/64 of the map size */
+#define RANK_BLOCK_BYTES 64
+
+static inline bool
+map_has(const Map *m, Id id)
+{
+    return id >= 0 && id < (m->size << 3) && MAPTST(m, id);
+}
+
+/**
+ * The set is either a dense bitmap sized to the pool or a sorted vector of ids. New sets start
+ * sparse and turn dense when they outgrow sparseLimit() or when getMap() or borrowMap() is
+ * called; compact() and intersecting with a sparse set turn them back, unless getMap() handed
+ * the bitmap out. Const readers never change the representation: the const getMap() of a sparse
+ * set returns a bitmap copy kept next to the ids.
+ */
 class PackageSet::Impl {
 public:
     Impl(DnfSack* sack);
@@ -36,7 +60,36 @@ public:
 private:
     friend PackageSet;
     DnfSack *sack;
+    bool dense;
+    /// The bitmap, allocated only while dense
     Map map;
+    /// Sorted ids, used only while not dense
+    std::vector<Id> ids;
+    /// The map was returned by getMap(), the set must stay dense so the pointer stays valid
+    bool mapShared{false};
+    /// Guards the lazily built members below against concurrent const readers
+    mutable std::mutex lazyMutex;
+    /// Number of set bits before every RANK_BLOCK_BYTES block, built by operator[] on demand
+    mutable std::vector<size_t> blockRanks;
+    mutable std::atomic<bool> ranksValid{false};
+    /// Bitmap copy of ids, built by the const getMap() on demand
+    mutable Map idsMap;
+    mutable std::atomic<bool> idsMapValid{false};
+
+    /// Drop the lazily built members, called for every change of the set
+    void invalidateCaches() noexcept
+    {
+        ranksValid.store(false, std::memory_order_relaxed);
+        idsMapValid.store(false, std::memory_order_relaxed);
+    }
+    void buildRanks() const;
+    const Map *getIdsMap() const;
+    size_t sparseLimit() const;
+    void toDense();
+    void toSparse();
+    bool has(Id id) const { return dense ? map_has(&map, id) : std::binary_search(ids.begin(), ids.end(), id); }
+    template<typename Predicate>
+    void keepIds(Predicate keep);
 };
 
 PackageSet::PackageSet(DnfSack* sack) : pImpl(new Impl(sack)) {}
@@ -46,46 +99,139 @@ PackageSet::PackageSet(PackageSet && pset): pImpl(std::move(pset.pImpl)) {}
 PackageSet::~PackageSet() = default;
 
 PackageSet::Impl::Impl(DnfSack* sack) :
-sack(sack)
+sack(sack), dense(false)
 {
-    map_init(&map, dnf_sack_get_pool(sack)->nsolvables);
+    map_init(&map, 0);
+    map_init(&idsMap, 0);
 }
-PackageSet::Impl::Impl(DnfSack* sack, Map* map_source) : sack(sack)
+PackageSet::Impl::Impl(DnfSack* sack, Map* map_source) : sack(sack), dense(true)
 {
     map_init_clone(&map, map_source);
+    map_init(&idsMap, 0);
 }
-PackageSet::Impl::Impl(const PackageSet & pset): sack(pset.pImpl->sack)
+PackageSet::Impl::Impl(const PackageSet & pset): sack(pset.pImpl->sack), dense(pset.pImpl->dense),
+ids(pset.pImpl->ids)
 {
-    map_init_clone(&map, &pset.pImpl->map);
+    if (dense)
+        map_init_clone(&map, &pset.pImpl->map);
+    else
+        map_init(&map, 0);
+    map_init(&idsMap, 0);
+}
+PackageSet::Impl::~Impl()
+{
+    map_free(&map);
+    map_free(&idsMap);
+}
+
+size_t
+PackageSet::Impl::sparseLimit() const
+{
+    return static_cast<size_t>(dnf_sack_get_pool(sack)->nsolvables) / SPARSE_RATIO;
+}
+
+void
+PackageSet::Impl::toDense()
+{
+    int nsolvables = dnf_sack_get_pool(sack)->nsolvables;
+    map_free(&map);
+    map_init(&map, ids.empty() || ids.back() < nsolvables ? nsolvables : ids.back() + 1);
+    for (auto id : ids)
+        MAPSET(&map, id);
+    std::vector<Id>().swap(ids);
+    dense = true;
+    invalidateCaches();
+}
+
+void
+PackageSet::Impl::toSparse()
+{
+    ids.clear();
+    for (size_t offset = 0; offset < static_cast<size_t>(map.size); offset += sizeof(uint64_t)) {
+        for (uint64_t word = map_load_word(&map, offset); word; word &= word - 1)
+            ids.push_back((offset << 3) + __builtin_ctzll(word));
+    }
+    map_free(&map);
+    map_init(&map, 0);
+    dense = false;
+    invalidateCaches();
+}
+
+template<typename Predicate>
+void
+PackageSet::Impl::keepIds(Predicate keep)
+{
+    invalidateCaches();
+    ids.erase(std::remove_if(ids.begin(), ids.end(), [&keep](Id id) { return !keep(id); }),
+              ids.end());
+}
+
+void
+PackageSet::Impl::buildRanks() const
+{
+    std::lock_guard<std::mutex> guard(lazyMutex);
+    if (ranksValid.load(std::memory_order_relaxed))
+        return;
+
+    size_t nblocks = (map.size + RANK_BLOCK_BYTES - 1) / RANK_BLOCK_BYTES;
+    size_t rank = 0;
+
+    blockRanks.resize(nblocks);
+    for (size_t block = 0; block < nblocks; ++block) {
+        blockRanks[block] = rank;
+        size_t end = std::min(static_cast<size_t>(map.size), (block + 1) * RANK_BLOCK_BYTES);
+        for (size_t offset = block * RANK_BLOCK_BYTES; offset < end; offset += sizeof(uint64_t))
+            rank += __builtin_popcountll(map_load_word(&map, offset));
+    }
+    ranksValid.store(true, std::memory_order_release);
+}
+
+const Map *
+PackageSet::Impl::getIdsMap() const
+{
+    if (idsMapValid.load(std::memory_order_acquire))
+        return &idsMap;
+
+    std::lock_guard<std::mutex> guard(lazyMutex);
+    if (!idsMapValid.load(std::memory_order_relaxed)) {
+        int nsolvables = dnf_sack_get_pool(sack)->nsolvables;
+        map_free(&idsMap);
+        map_init(&idsMap, ids.empty() || ids.back() < nsolvables ? nsolvables : ids.back() + 1);
+        for (auto id : ids)
+            MAPSET(&idsMap, id);
+        idsMapValid.store(true, std::memory_order_release);
+    }
+    return &idsMap;
 }
-PackageSet::Impl::~Impl() { map_free(&map); }
 
 Id
 PackageSet::operator [](unsigned int index) const
 {
-    const unsigned char *ti = pImpl->map.map;
-    const unsigned char *end = ti + pImpl->map.size;
-    unsigned int enabled;
-    Id id;
+    if (!pImpl->dense)
+        return index < pImpl->ids.size() ? pImpl->ids[index] : -1;
+
+    if (!pImpl->ranksValid.load(std::memory_order_acquire))
+        pImpl->buildRanks();
+    auto & ranks = pImpl->blockRanks;
 
-    while (ti < end) {
-        enabled = _BitCountLookup[*ti];
+    // the last block starting at or before the index-th set bit
+    auto block = std::upper_bound(ranks.begin(), ranks.end(), static_cast<size_t>(index));
+    if (block == ranks.begin())
+        return -1;
+    --block;
+    size_t remaining = index - *block;
+    size_t offset = (block - ranks.begin()) * RANK_BLOCK_BYTES;
 
-        if (index >= enabled ){
-            index -= enabled;
-            ti++;
+    for (; offset < static_cast<size_t>(pImpl->map.size); offset += sizeof(uint64_t)) {
+        uint64_t word = map_load_word(&pImpl->map, offset);
+        size_t enabled = __builtin_popcountll(word);
+        if (remaining >= enabled) {
+            remaining -= enabled;
             continue;
         }
-        id = (ti - pImpl->map.map) << 3;
-
-        index++;
-        for (unsigned char byte = *ti; index; byte >>= 1) {
-            if ((byte & 0x01))
-                index--;
-            if (index)
-                id++;
-        }
-        return id;
+        for (; remaining; --remaining)
+            word &= word - 1;
+        return (offset << 3) + __builtin_ctzll(word);
     }
     return -1;
 }
@@ -93,27 +239,81 @@ PackageSet::operator [](unsigned int index) const
 PackageSet &
 PackageSet::operator +=(const PackageSet & other)
 {
-    map_or(&pImpl->map, &other.pImpl->map);
+    auto & otherIds = other.pImpl->ids;
+    pImpl->invalidateCaches();
+    if (other.pImpl->dense) {
+        if (!pImpl->dense)
+            pImpl->toDense();
+        map_or(&pImpl->map, &other.pImpl->map);
+    } else if (pImpl->dense) {
+        if (!otherIds.empty() && otherIds.back() >= (pImpl->map.size << 3))
+            map_grow(&pImpl->map, otherIds.back() + 1);
+        for (auto id : otherIds)
+            MAPSET(&pImpl->map, id);
+    } else {
+        std::vector<Id> merged;
+        merged.reserve(pImpl->ids.size() + otherIds.size());
+        std::set_union(pImpl->ids.begin(), pImpl->ids.end(), otherIds.begin(), otherIds.end(),
+                       std::back_inserter(merged));
+        pImpl->ids.swap(merged);
+        if (pImpl->ids.size() > pImpl->sparseLimit())
+            pImpl->toDense();
+    }
     return *this;
 }
 
 PackageSet &
 PackageSet::operator -=(const PackageSet & other)
 {
-    map_subtract(&pImpl->map, &other.pImpl->map);
+    auto otherImpl = other.pImpl.get();
+    pImpl->invalidateCaches();
+    if (pImpl->dense && otherImpl->dense) {
+        map_subtract(&pImpl->map, &otherImpl->map);
+    } else if (pImpl->dense) {
+        for (auto id : otherImpl->ids)
+            if (id < (pImpl->map.size << 3))
+                MAPCLR(&pImpl->map, id);
+    } else {
+        pImpl->keepIds([otherImpl](Id id) { return !otherImpl->has(id); });
+    }
     return *this;
 }
 
 PackageSet &
 PackageSet::operator /=(const PackageSet & other)
 {
-    map_and(&pImpl->map, &other.pImpl->map);
+    auto otherImpl = other.pImpl.get();
+    pImpl->invalidateCaches();
+    if (pImpl->dense && otherImpl->dense) {
+        map_and(&pImpl->map, &otherImpl->map);
+    } else if (pImpl->dense) {
+        // the intersection is no larger than the sparse operand, so it stays sparse
+        std::vector<Id> common;
+        for (auto id : otherImpl->ids)
+            if (map_has(&pImpl->map, id))
+                common.push_back(id);
+        if (pImpl->mapShared) {
+            map_empty(&pImpl->map);
+            for (auto id : common)
+                MAPSET(&pImpl->map, id);
+            return *this;
+        }
+        map_free(&pImpl->map);
+        map_init(&pImpl->map, 0);
+        pImpl->ids.swap(common);
+        pImpl->dense = false;
+    } else {
+        pImpl->keepIds([otherImpl](Id id) { return otherImpl->has(id); });
+    }
     return *this;
 }
 
 PackageSet &
 PackageSet::operator +=(const Map * other)
 {
+    pImpl->invalidateCaches();
+    if (!pImpl->dense)
+        pImpl->toDense();
     map_or(&pImpl->map, const_cast<Map *>(other));
     return *this;
 }
@@ -121,76 +321,153 @@ PackageSet::operator +=(const Map * other)
 PackageSet &
 PackageSet::operator -=(const Map * other)
 {
-    map_subtract(&pImpl->map, const_cast<Map *>(other));
+    pImpl->invalidateCaches();
+    if (pImpl->dense)
+        map_subtract(&pImpl->map, const_cast<Map *>(other));
+    else
+        pImpl->keepIds([other](Id id) { return !map_has(other, id); });
     return *this;
 }
 
 PackageSet &
 PackageSet::operator /=(const Map * other)
 {
-    map_and(&pImpl->map, const_cast<Map *>(other));
+    pImpl->invalidateCaches();
+    if (pImpl->dense)
+        map_and(&pImpl->map, const_cast<Map *>(other));
+    else
+        pImpl->keepIds([other](Id id) { return map_has(other, id); });
     return *this;
 }
 
 void
 PackageSet::clear()
 {
-    map_empty(&pImpl->map);
+    pImpl->invalidateCaches();
+    // a dense set stays dense, pointers returned by getMap() must remain usable
+    if (pImpl->dense)
+        map_empty(&pImpl->map);
+    else
+        pImpl->ids.clear();
 }
 
 bool
 PackageSet::empty()
 {
-    const unsigned char *res = pImpl->map.map;
-    const unsigned char *end = res + pImpl->map.size;
-
-    while (res < end) {
-        if (*res++)
+    if (!pImpl->dense)
+        return pImpl->ids.empty();
+    for (size_t offset = 0; offset < static_cast<size_t>(pImpl->map.size); offset += sizeof(uint64_t)) {
+        if (map_load_word(&pImpl->map, offset))
             return false;
     }
     return true;
 }
 
+void
+PackageSet::compact()
+{
+    if (pImpl->dense && !pImpl->mapShared && map_count(&pImpl->map) <= pImpl->sparseLimit())
+        pImpl->toSparse();
+}
 
-void PackageSet::set(DnfPackage *pkg) { MAPSET(&pImpl->map, dnf_package_get_id(pkg)); }
-void PackageSet::set(Id id) { MAPSET(&pImpl->map, id); }
-bool PackageSet::has(DnfPackage *pkg) const { return MAPTST(&pImpl->map, dnf_package_get_id(pkg)); }
-bool PackageSet::has(Id id) const { return MAPTST(&pImpl->map, id); }
-void PackageSet::remove(Id id) { MAPCLR(&pImpl->map, id); }
-Map *PackageSet::getMap() const { return &pImpl->map; }
-DnfSack *PackageSet::getSack() const { return pImpl->sack; }
-size_t PackageSet::size() const { return map_count(&pImpl->map); }
+bool
+PackageSet::isSparse() const noexcept
+{
+    return !pImpl->dense;
+}
 
-Id PackageSet::next(Id previous) const
+void
+PackageSet::set(Id id)
 {
-    const unsigned char *ti = pImpl->map.map;
-    const unsigned char *end = ti + pImpl->map.size;
-    Id id;
+    pImpl->invalidateCaches();
+    if (pImpl->dense) {
+        MAPSET(&pImpl->map, id);
+        return;
+    }
+    auto & ids = pImpl->ids;
+    if (ids.empty() || ids.back() < id) {
+        ids.push_back(id);
+    } else {
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (*it == id)
+            return;
+        ids.insert(it, id);
+    }
+    if (ids.size() > pImpl->sparseLimit())
+        pImpl->toDense();
+}
 
-    if (previous >= 0) {
-        ti += previous >> 3;
-        unsigned char byte = *ti; // byte with the previous match
-        byte >>= (previous & 7) + 1; // shift away all previous 1 bits
+void
+PackageSet::remove(Id id)
+{
+    pImpl->invalidateCaches();
+    if (pImpl->dense) {
+        MAPCLR(&pImpl->map, id);
+        return;
+    }
+    auto & ids = pImpl->ids;
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it != ids.end() && *it == id)
+        ids.erase(it);
+}
 
-        for (id = previous + 1; byte; byte >>= 1, id++)
-            if (byte & 0x01)
-                return id;
-        ti++;
+Map *
+PackageSet::getMap()
+{
+    pImpl->mapShared = true;
+    return borrowMap();
+}
+
+Map *
+PackageSet::borrowMap()
+{
+    if (!pImpl->dense)
+        pImpl->toDense();
+    pImpl->invalidateCaches();
+    return &pImpl->map;
+}
+
+const Map *
+PackageSet::getMap() const
+{
+    return pImpl->dense ? &pImpl->map : pImpl->getIdsMap();
+}
+
+void PackageSet::set(DnfPackage *pkg) { set(dnf_package_get_id(pkg)); }
+bool PackageSet::has(DnfPackage *pkg) const { return has(dnf_package_get_id(pkg)); }
+bool PackageSet::has(Id id) const
+{
+    return pImpl->dense ? MAPTST(&pImpl->map, id) : pImpl->has(id);
+}
+DnfSack *PackageSet::getSack() const { return pImpl->sack; }
+size_t PackageSet::size() const
+{
+    return pImpl->dense ? map_count(&pImpl->map) : pImpl->ids.size();
+}
+
+Id PackageSet::next(Id previous) const
+{
+    if (!pImpl->dense) {
+        auto & ids = pImpl->ids;
+        auto it = std::upper_bound(ids.begin(), ids.end(), previous);
+        return it != ids.end() ? *it : -1;
     }
 
-    while (ti < end) {
+    const Map *map = &pImpl->map;
+    size_t start = previous >= 0 ? static_cast<size_t>(previous) + 1 : 0;
+    size_t offset = (start >> 6) << 3;
 
-        if (!*ti){
-            ti++;
-            continue;
-        }
-        id = (ti - pImpl->map.map) << 3;
-        for (unsigned char byte = *ti; 1; byte >>= 1, id++) {
-            if (byte & 0x01)
-                return id;
-        }
+    if (offset >= static_cast<size_t>(map->size))
+        return -1;
+    // mask away the bits up to and including the previous match
+    uint64_t word = map_load_word(map, offset) & (~static_cast<uint64_t>(0) << (start & 63));
+    while (!word) {
+        offset += sizeof(uint64_t);
+        if (offset >= static_cast<size_t>(map->size))
+            return -1;
+        word = map_load_word(map, offset);
     }
-    return -1;
+    return (offset << 3) + __builtin_ctzll(word);
 }
 
 }
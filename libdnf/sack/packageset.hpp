@@ -50,7 +50,21 @@ public:
     bool has(DnfPackage *pkg) const;
     bool has(Id id) const;
     void remove(Id id);
-    Map *getMap() const;
+    /**
+    * @brief Returns the set as a libsolv bitmap, converting a sparse set to the dense form first.
+    * The set stays dense from then on, so the Map stays valid as long as the set does.
+    */
+    Map *getMap();
+    /**
+    * @brief Returns a read-only libsolv bitmap of the set without changing it, safe to call from
+    * several threads at once. The Map is valid until the set is changed.
+    */
+    const Map *getMap() const;
+    /**
+    * @brief Like getMap(), but the Map is valid only until the set is intersected with a sparse
+    * set or compacted. For internal changes of the set that should not keep it dense.
+    */
+    Map *borrowMap();
     DnfSack *getSack() const;
     size_t size() const;
 
@@ -62,6 +76,14 @@ public:
     */
     Id next(Id previous) const;
 
+    /**
+    * @brief Switch to the sorted id array if the set is small enough compared to the pool
+    */
+    void compact();
+
+    /// Returns true while the set is stored as a sorted id array instead of a bitmap
+    bool isSparse() const noexcept;
+
 private:
     class Impl;
     std::unique_ptr<Impl> pImpl;
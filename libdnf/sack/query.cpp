@@ -22,7 +22,12 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #include <fnmatch.h>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 extern "C" {
@@ -37,6 +42,7 @@ extern "C" {
 #include "../hy-util-private.hpp"
 #include "../hy-iutil.h"
 #include "../nevra.hpp"
+#include "../repo/DependencySplitter.hpp"
 #include "../hy-query-private.hpp"
 #include "../dnf-sack-private.hpp"
 #include "../dnf-advisorypkg.h"
@@ -145,42 +151,6 @@ NevraID::parse(Pool * pool, const char * nevraPattern, bool createEVRId)
     return true;
 }
 
-static bool
-nevraIDSorter(const NevraID & first, const NevraID & second)
-{
-    if (first.name != second.name)
-        return first.name < second.name;
-    if (first.arch != second.arch)
-        return first.arch < second.arch;
-    return first.evr < second.evr;
-}
-
-static bool
-nevraCompareLowerSolvable(const NevraID &first, const Solvable &s)
-{
-    if (first.name != s.name)
-        return first.name < s.name;
-    if (first.arch != s.arch)
-        return first.arch < s.arch;
-    return first.evr < s.evr;
-}
-
-static bool
-nevraNameArchKey(const NevraID & first, const NevraID & second)
-{
-    if (first.name != second.name)
-        return first.name < second.name;
-    return first.arch < second.arch;
-}
-
-static bool
-nameArchCompareLowerSolvable(const NevraID &first, const Solvable &s)
-{
-    if (first.name != s.name)
-        return first.name < s.name;
-    return first.arch < s.arch;
-}
-
 static bool
 NameArchSolvableComparator(const Solvable * first, const Solvable * second)
 {
@@ -447,119 +417,181 @@ type2flags(int type, int keyname)
     }
 }
 
-static char *
-pool_solvable_epoch_optional_2str(Pool *pool, const Solvable *s, gboolean with_epoch)
+/**
+* @brief Estimated cost of a filter, cheap and selective filters get lower numbers
+*
+* @return int Negative value for filters whose matches depend on the packages already in the
+*         result (latest, by-priority and advisory filters). They can not be moved.
+*/
+static int
+filter_cost(const Filter & f)
 {
-    const char *e;
-    const char *name = pool_id2str(pool, s->name);
-    const char *evr = pool_id2str(pool, s->evr);
-    const char *arch = pool_id2str(pool, s->arch);
-    bool present_epoch = false;
-
-    for (e = evr + 1; *e != '-' && *e != '\0'; ++e) {
-        if (*e == ':') {
-            present_epoch = true;
-            break;
-        }
-    }
-    char *output_string;
-    int evr_length, arch_length;
-    int extra_epoch_length = 0;
-    int name_length = strlen(name);
-    evr_length = strlen(evr);
-    arch_length = strlen(arch);
-    if (!present_epoch && with_epoch) {
-        extra_epoch_length = 2;
-    } else if (present_epoch && !with_epoch) {
-        extra_epoch_length = evr - e - 1;
-    }
-
-    output_string = pool_alloctmpspace(
-        pool, name_length + evr_length + extra_epoch_length + arch_length + 3);
-
-    strcpy(output_string, name);
-
-    if (evr_length || extra_epoch_length > 0) {
-        output_string[name_length++] = '-';
-
-        if (extra_epoch_length > 0) {
-            output_string[name_length++] = '0';
-            output_string[name_length++] = ':';
-            output_string[name_length] = '\0';
-        }
+    int cmpType = f.getCmpType();
+    switch (f.getKeyname()) {
+        case HY_PKG_ALL:
+        case HY_PKG_EMPTY:
+        case HY_PKG:
+            return 0;
+        case HY_PKG_REPONAME:
+        case HY_PKG_ARCH:
+            return 1;
+        case HY_PKG_NAME:
+            return (cmpType & HY_EQ) && !(cmpType & HY_ICASE) ? 1 : 2;
+        case HY_PKG_EPOCH:
+        case HY_PKG_EVR:
+        case HY_PKG_VERSION:
+        case HY_PKG_RELEASE:
+        case HY_PKG_NEVRA:
+        case HY_PKG_SOURCERPM:
+        case HY_PKG_LOCATION:
+            return 2;
+        case HY_PKG_CONFLICTS:
+        case HY_PKG_ENHANCES:
+        case HY_PKG_OBSOLETES:
+        case HY_PKG_PROVIDES:
+        case HY_PKG_RECOMMENDS:
+        case HY_PKG_REQUIRES:
+        case HY_PKG_SUGGESTS:
+        case HY_PKG_SUPPLEMENTS:
+        case HY_PKG_DOWNGRADABLE:
+        case HY_PKG_DOWNGRADES:
+        case HY_PKG_UPGRADABLE:
+        case HY_PKG_UPGRADES:
+            return 3;
+        case HY_PKG_DESCRIPTION:
+        case HY_PKG_FILE:
+        case HY_PKG_SUMMARY:
+        case HY_PKG_URL:
+            return 4;
+        default:
+            return -1;
     }
+}
 
-    if (evr_length) {
-        if (extra_epoch_length >= 0) {
-            strcpy(output_string + name_length, evr);
-        } else {
-            strcpy(output_string + name_length, evr - extra_epoch_length);
-            evr_length = evr_length + extra_epoch_length;
-        }
+/**
+* @brief Reorder filters by estimated cost. Filters only narrow the result and those with
+* a non-negative cost test every package on its own, so they commute. Filters that depend
+* on the current result stay in place and split the list into independently sorted runs.
+*/
+static void
+plan_filters(std::vector<Filter> & filters)
+{
+    auto cheaper = [](const Filter & first, const Filter & second) {
+        // negated filters rarely remove much, run them after positive ones of the same cost
+        int firstCost = filter_cost(first) * 2 + ((first.getCmpType() & HY_NOT) ? 1 : 0);
+        int secondCost = filter_cost(second) * 2 + ((second.getCmpType() & HY_NOT) ? 1 : 0);
+        return firstCost < secondCost;
+    };
+    auto runStart = filters.begin();
+    for (auto it = filters.begin(); it != filters.end(); ++it) {
+        if (filter_cost(*it) >= 0)
+            continue;
+        std::stable_sort(runStart, it, cheaper);
+        runStart = it + 1;
     }
+    std::stable_sort(runStart, filters.end(), cheaper);
+}
 
-    if (arch_length) {
-        output_string[name_length + evr_length] = '.';
-        strcpy(output_string + name_length + evr_length + 1, arch);
+static const char *
+filter_keyname2str(int keyname)
+{
+    switch (keyname) {
+        case HY_PKG: return "pkg";
+        case HY_PKG_ALL: return "all";
+        case HY_PKG_ARCH: return "arch";
+        case HY_PKG_CONFLICTS: return "conflicts";
+        case HY_PKG_DESCRIPTION: return "description";
+        case HY_PKG_EPOCH: return "epoch";
+        case HY_PKG_EVR: return "evr";
+        case HY_PKG_FILE: return "file";
+        case HY_PKG_NAME: return "name";
+        case HY_PKG_NEVRA: return "nevra";
+        case HY_PKG_OBSOLETES: return "obsoletes";
+        case HY_PKG_PROVIDES: return "provides";
+        case HY_PKG_RELEASE: return "release";
+        case HY_PKG_REPONAME: return "reponame";
+        case HY_PKG_REQUIRES: return "requires";
+        case HY_PKG_SOURCERPM: return "sourcerpm";
+        case HY_PKG_SUMMARY: return "summary";
+        case HY_PKG_URL: return "url";
+        case HY_PKG_VERSION: return "version";
+        case HY_PKG_LOCATION: return "location";
+        case HY_PKG_ENHANCES: return "enhances";
+        case HY_PKG_RECOMMENDS: return "recommends";
+        case HY_PKG_SUGGESTS: return "suggests";
+        case HY_PKG_SUPPLEMENTS: return "supplements";
+        case HY_PKG_ADVISORY: return "advisory";
+        case HY_PKG_ADVISORY_BUG: return "advisory_bug";
+        case HY_PKG_ADVISORY_CVE: return "advisory_cve";
+        case HY_PKG_ADVISORY_SEVERITY: return "advisory_severity";
+        case HY_PKG_ADVISORY_TYPE: return "advisory_type";
+        case HY_PKG_DOWNGRADABLE: return "downgradable";
+        case HY_PKG_DOWNGRADES: return "downgrades";
+        case HY_PKG_EMPTY: return "empty";
+        case HY_PKG_LATEST_PER_ARCH: return "latest_per_arch";
+        case HY_PKG_LATEST: return "latest";
+        case HY_PKG_UPGRADABLE: return "upgradable";
+        case HY_PKG_UPGRADES: return "upgrades";
+        case HY_PKG_NEVRA_STRICT: return "nevra_strict";
+        case HY_PKG_UPGRADES_BY_PRIORITY: return "upgrades_by_priority";
+        case HY_PKG_OBSOLETES_BY_PRIORITY: return "obsoletes_by_priority";
+        case HY_PKG_LATEST_PER_ARCH_BY_PRIORITY: return "latest_per_arch_by_priority";
+        default: return "unknown";
+    }
+}
+
+static std::string
+filter_cmp_type2str(int cmpType)
+{
+    static const std::pair<int, const char *> names[] = {
+        {HY_EQ, "eq"}, {HY_LT, "lt"}, {HY_GT, "gt"}, {HY_SUBSTR, "substr"}, {HY_GLOB, "glob"},
+        {HY_NOT, "not"}, {HY_ICASE, "icase"}, {HY_NAME_ONLY, "name_only"}, {HY_EQG, "eqg"},
+        {HY_UPGRADE, "upgrade"}};
+    std::string ret;
+    for (const auto & name : names) {
+        if (!(cmpType & name.first))
+            continue;
+        if (!ret.empty())
+            ret += '|';
+        ret += name.second;
     }
-    return output_string;
+    return ret;
 }
 
-static int
-filter_latest_sortcmp(const void *ap, const void *bp, void *dp)
+/**
+* @brief Write the NEVRA of a solvable into output, adding a "0:" epoch or dropping the epoch of
+* the package as with_epoch asks
+*
+* Unlike the pool_solvable2str() family it does not use the pool's temporary space, so it can be
+* called from several threads at once.
+*/
+static void
+solvable_epoch_optional_2str(Pool *pool, const Solvable *s, bool with_epoch, std::string & output)
 {
-    auto pool = static_cast<Pool *>(dp);
-    Solvable *sa = pool->solvables + *(Id *)ap;
-    Solvable *sb = pool->solvables + *(Id *)bp;
-    int r;
-    r = sa->name - sb->name;
-    if (r)
-        return r;
-    r = pool_evrcmp(pool, sb->evr, sa->evr, EVRCMP_COMPARE);
-    if (r)
-        return r;
-    return *(Id *)ap - *(Id *)bp;
-}
+    const char *name = pool_id2str(pool, s->name);
+    const char *evr = pool_id2str(pool, s->evr);
+    const char *arch = pool_id2str(pool, s->arch);
+    const char *epoch_end = nullptr;
 
-static int
-filter_latest_sortcmp_byarch(const void *ap, const void *bp, void *dp)
-{
-    auto pool = static_cast<Pool *>(dp);
-    Solvable *sa = pool->solvables + *(Id *)ap;
-    Solvable *sb = pool->solvables + *(Id *)bp;
-    int r;
-    r = sa->name - sb->name;
-    if (r)
-        return r;
-    r = sa->arch - sb->arch;
-    if (r)
-        return r;
-    r = pool_evrcmp(pool, sb->evr, sa->evr, EVRCMP_COMPARE);
-    if (r)
-        return r;
-    return *(Id *)ap - *(Id *)bp;
-}
+    if (*evr) {
+        for (const char *e = evr + 1; *e != '-' && *e != '\0'; ++e) {
+            if (*e == ':') {
+                epoch_end = e;
+                break;
+            }
+        }
+    }
 
-static int
-filter_latest_sortcmp_byarch_bypriority(const void *ap, const void *bp, void *dp)
-{
-    auto pool = static_cast<Pool *>(dp);
-    Solvable *sa = pool->solvables + *(Id *)ap;
-    Solvable *sb = pool->solvables + *(Id *)bp;
-    int r;
-    r = sa->name - sb->name;
-    if (r)
-        return r;
-    r = sa->arch - sb->arch;
-    if (r)
-        return r;
-    r = sb->repo->priority - sa->repo->priority;
-    if (r)
-        return r;
-    r = pool_evrcmp(pool, sb->evr, sa->evr, EVRCMP_COMPARE);
-    if (r)
-        return r;
-    return *(Id *)ap - *(Id *)bp;
+    output.assign(name);
+    if (*evr || (with_epoch && !epoch_end))
+        output += '-';
+    if (with_epoch && !epoch_end)
+        output += "0:";
+    output += (epoch_end && !with_epoch) ? epoch_end + 1 : evr;
+    if (*arch) {
+        output += '.';
+        output += arch;
+    }
 }
 
 /**
@@ -621,16 +653,6 @@ add_duplicates_to_map(Pool *pool, Map *res, IdQueue & samename, int start_block,
     }
 }
 
-static bool
-advisoryPkgSort(const AdvisoryPkg &first, const AdvisoryPkg &second)
-{
-    if (first.getName() != second.getName())
-        return first.getName() < second.getName();
-    if (first.getArch() != second.getArch())
-        return first.getArch() < second.getArch();
-    return first.getEVR() < second.getEVR();
-}
-
 static bool
 advisoryPkgCompareSolvable(const AdvisoryPkg &first, const Solvable &s)
 {
@@ -793,7 +815,17 @@ private:
     Query::ExcludeFlags flags;
     std::unique_ptr<PackageSet> result;
     std::vector<Filter> filters;
+    /// How the filters of the last apply() were evaluated, reported by Query::explain()
+    struct PlanStep {
+        Filter filter;
+        bool evaluated;
+        double ms;
+        size_t cardinality;
+    };
+    size_t initialCardinality{0};
+    std::vector<PlanStep> plan;
     void apply();
+    void applyFilter(const Filter & f, Map *m);
     Map *considered_cached = nullptr;
 
     /**
@@ -830,6 +862,7 @@ private:
     void filterUpdownByPriority(const Filter & f, Map *m);
     void filterUpdownAble(const Filter  &f, Map *m);
     void filterDataiterator(const Filter & f, Map *m);
+    bool filterFileIndex(const Filter & f, Map *m);
     int filterUnneededOrSafeToRemove(const Swdb &swdb, bool debug_solver, bool safeToRemove);
     void obsoletesByPriority(Pool * pool, Solvable * candidate, Map * m, const Map * target, int obsprovides);
 
@@ -850,6 +883,8 @@ Query::Impl::Impl(const Query::Impl & src)
 , sack(src.sack)
 , flags(src.flags)
 , filters(src.filters)
+, initialCardinality(src.initialCardinality)
+, plan(src.plan)
 {
     if (src.result) {
         result.reset(new PackageSet(*src.result.get()));
@@ -863,6 +898,8 @@ Query::Impl::operator=(const Query::Impl & src)
     sack = src.sack;
     flags = src.flags;
     filters = src.filters;
+    initialCardinality = src.initialCardinality;
+    plan = src.plan;
     if (src.result) {
         result.reset(new PackageSet(*src.result.get()));
     } else {
@@ -901,6 +938,7 @@ Query::clear()
     pImpl->applied = false;
     pImpl->result.reset();
     pImpl->filters.clear();
+    pImpl->plan.clear();
 }
 
 size_t
@@ -1113,90 +1151,39 @@ Query::Impl::filterNevraStrict(int cmpType, const char **matches)
     }
     if (compareSet.empty()) {
         if (!(cmpType & HY_NOT))
-            map_empty(result->getMap());
+            map_empty(result->borrowMap());
         return;
     }
     Map nevraResult;
     map_init(&nevraResult, pool->nsolvables);
 
-    //  if cmpType == HY_EQ or cmpType == (HY_EQ | HY_NOT) -> performance optimization
-    if (createEVRId) {
-        if (compareSet.size() > 1) {
-            std::sort(compareSet.begin(), compareSet.end(), nevraIDSorter);
-
-            Id id = -1;
-            while (true) {
-                id = result->next(id);
-                if (id == -1)
-                    break;
-                Solvable* s = pool_id2solvable(pool, id);
-                auto low = std::lower_bound(compareSet.begin(), compareSet.end(), *s,
-                                            nevraCompareLowerSolvable);
-                if (low != compareSet.end() && low->name == s->name && low->arch == s->arch
-                    && low->evr == s->evr) {
-                    MAPSET(&nevraResult, id);
-                }
-            }
-        } else {
-            NevraID & nevraId = compareSet[0];
-            Id id = -1;
-            while (true) {
-                id = result->next(id);
-                if (id == -1)
-                    break;
-                Solvable* s = pool_id2solvable(pool, id);
-                if (nevraId.name == s->name && nevraId.arch == s->arch && nevraId.evr == s->evr) {
+    auto nameIndex = dnf_sack_get_name_index(sack);
+    auto resultPset = result.get();
+    for (const auto & nevraId : compareSet) {
+        auto range = nameIndex->byName(nevraId.name);
+        for (auto it = range.first; it != range.second; ++it) {
+            Id id = it->second;
+            Solvable* s = pool_id2solvable(pool, id);
+            if (s->arch != nevraId.arch || !resultPset->has(id))
+                continue;
+            //  if cmpType == HY_EQ or cmpType == (HY_EQ | HY_NOT) -> performance optimization
+            if (createEVRId) {
+                if (s->evr == nevraId.evr)
                     MAPSET(&nevraResult, id);
-                }
-            }
-        }
-    } else {
-        if (compareSet.size() > 1) {
-            std::sort(compareSet.begin(), compareSet.end(), nevraNameArchKey);
-
-            Id id = -1;
-            while (true) {
-                id = result->next(id);
-                if (id == -1)
-                    break;
-                Solvable* s = pool_id2solvable(pool, id);
-                auto low = std::lower_bound(compareSet.begin(), compareSet.end(), *s,
-                                            nameArchCompareLowerSolvable);
-                while (low != compareSet.end() && low->name == s->name && low->arch == s->arch) {
-                    int cmp = pool_evrcmp_str(
-                        pool, pool_id2str(pool, s->evr), low->evr_str.c_str(), EVRCMP_COMPARE);
-
-                    if ((cmp > 0 && cmpType & HY_GT) || (cmp < 0 && cmpType & HY_LT)
-                        || (cmp == 0 && cmpType & HY_EQ)) {
-                        MAPSET(&nevraResult, id);
-                        break;
-                    }
-                    ++low;
-                }
+                continue;
             }
-        } else {
-            auto & nevraId = compareSet[0];
-            Id id = -1;
-            while (true) {
-                id = result->next(id);
-                if (id == -1)
-                    break;
-                Solvable* s = pool_id2solvable(pool, id);
-                if (nevraId.name == s->name && nevraId.arch == s->arch) {
-                    int cmp = pool_evrcmp_str(
-                        pool, pool_id2str(pool, s->evr), nevraId.evr_str.c_str(), EVRCMP_COMPARE);
-                    if ((cmp > 0 && cmpType & HY_GT) || (cmp < 0 && cmpType & HY_LT) ||
-                        (cmp == 0 && cmpType & HY_EQ)) {
-                        MAPSET(&nevraResult, id);
-                    }
-                }
+            int cmp = pool_evrcmp_str(
+                pool, pool_id2str(pool, s->evr), nevraId.evr_str.c_str(), EVRCMP_COMPARE);
+            if ((cmp > 0 && cmpType & HY_GT) || (cmp < 0 && cmpType & HY_LT) ||
+                (cmp == 0 && cmpType & HY_EQ)) {
+                MAPSET(&nevraResult, id);
             }
         }
     }
     if (cmpType & HY_NOT)
-        map_subtract(result->getMap(), &nevraResult);
+        map_subtract(result->borrowMap(), &nevraResult);
     else
-        map_and(result->getMap(), &nevraResult);
+        map_and(result->borrowMap(), &nevraResult);
     map_free(&nevraResult);
 }
 
@@ -1212,16 +1199,16 @@ Query::Impl::initResult()
         result.reset(new PackageSet(sack));
         FOR_PKG_SOLVABLES(solvid)
             result->set(solvid);
-        dnf_sack_set_pkg_solvables(sack, result->getMap(), pool->nsolvables);
+        dnf_sack_set_pkg_solvables(sack, result->borrowMap(), pool->nsolvables);
     }
     if (flags == Query::ExcludeFlags::APPLY_EXCLUDES) {
         dnf_sack_recompute_considered(sack);
         if (pool->considered)
-            map_and(result->getMap(), pool->considered);
+            map_and(result->borrowMap(), pool->considered);
     } else {
         dnf_sack_recompute_considered_map(sack, &considered_cached, flags);
         if (considered_cached) {
-            map_and(result->getMap(), considered_cached);
+            map_and(result->borrowMap(), considered_cached);
         }
     }
 }
@@ -1313,49 +1300,20 @@ Query::Impl::filterName(const Filter & f, Map *m)
     auto resultPset = result.get();
 
     if ((cmpType & HY_EQ) && !(cmpType & HY_ICASE)) {
-        Id match_name_id = 0;
-        if (f.getMatches().size() < 3) {
-            for (auto match_union : f.getMatches()) {
-                const char *match = match_union.str;
-                match_name_id = pool_str2id(pool, match, 0);
-                if (match_name_id == 0)
-                    continue;
-                Id id = -1;
-                while (true) {
-                    id = resultPset->next(id);
-                    if (id == -1)
-                        break;
-                    Solvable *s = pool_id2solvable(pool, id);
-                    if (match_name_id == s->name)
-                        MAPSET(m, id);
-                    continue;
-                }
-            }
-            return;
-        }
-        std::vector<Id> names;
+        auto nameIndex = dnf_sack_get_name_index(sack);
         for (auto match_union : f.getMatches()) {
-            const char *match = match_union.str;
-            match_name_id = pool_str2id(pool, match, 0);
+            Id match_name_id = pool_str2id(pool, match_union.str, 0);
             if (match_name_id == 0)
                 continue;
-            names.push_back(match_name_id);
-        }
-        std::sort(names.begin(), names.end());
-        Id id = -1;
-        while (true) {
-            id = resultPset->next(id);
-            if (id == -1)
-                break;
-            Solvable* s = pool_id2solvable(pool, id);
-            auto low = std::lower_bound(names.begin(), names.end(), s->name);
-            if (low != names.end() && (*low) == s->name) {
-                MAPSET(m, id);
+            auto range = nameIndex->byName(match_name_id);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (resultPset->has(it->second))
+                    MAPSET(m, it->second);
             }
         }
         return;
     }
-    
+
     for (auto match_union : f.getMatches()) {
         const char *match = match_union.str;
         Id id = -1;
@@ -1464,13 +1422,14 @@ Query::Impl::filterNevra(const Filter & f, Map *m)
     int cmp_type = f.getCmpType();
     int fn_flags = (HY_ICASE & cmp_type) ? FNM_CASEFOLD : 0;
     auto resultPset = result.get();
+    std::string nevra;
 
     for (auto match : f.getMatches()) {
         const char *nevra_pattern = match.str;
         if (strpbrk(nevra_pattern, "(/=<> "))
             continue;
 
-        gboolean present_epoch = strchr(nevra_pattern, ':') != NULL;
+        bool present_epoch = strchr(nevra_pattern, ':') != NULL;
 
         Id id = -1;
         while (true) {
@@ -1479,16 +1438,16 @@ Query::Impl::filterNevra(const Filter & f, Map *m)
                 break;
             Solvable* s = pool_id2solvable(pool, id);
 
-            char* nevra = pool_solvable_epoch_optional_2str(pool, s, present_epoch);
+            solvable_epoch_optional_2str(pool, s, present_epoch, nevra);
             if (!(HY_GLOB & cmp_type)) {
                 if (HY_ICASE & cmp_type) {
-                    if (strcasecmp(nevra_pattern, nevra) == 0)
+                    if (strcasecmp(nevra_pattern, nevra.c_str()) == 0)
                         MAPSET(m, id);
                 } else {
-                    if (strcmp(nevra_pattern, nevra) == 0)
+                    if (nevra == nevra_pattern)
                         MAPSET(m, id);
                 }
-            } else if (fnmatch(nevra_pattern, nevra, fn_flags) == 0) {
+            } else if (fnmatch(nevra_pattern, nevra.c_str(), fn_flags) == 0) {
                 MAPSET(m, id);
             }
         }
@@ -1618,33 +1577,49 @@ Query::Impl::filterArch(const Filter & f, Map *m)
     }
 }
 
+static void
+sourcerpm_match(DnfSack *sack, Id id, const char *match, Map *m)
+{
+    DnfPackage *pkg = dnf_package_new(sack, id);
+    const char *srcrpm = dnf_package_get_sourcerpm(pkg);
+    if (srcrpm && !strcmp(match, srcrpm))
+        MAPSET(m, id);
+    g_object_unref(pkg);
+}
+
 void
 Query::Impl::filterSourcerpm(const Filter & f, Map *m)
 {
     Pool *pool = dnf_sack_get_pool(sack);
     auto resultPset = result.get();
+    auto nameIndex = dnf_sack_get_name_index(sack);
 
     for (auto match_in : f.getMatches()) {
         const char *match = match_in.str;
 
-        Id id = -1;
-        while (true) {
-            id = resultPset->next(id);
-            if (id == -1)
-                break;
-            Solvable *s = pool_id2solvable(pool, id);
-
-            const char *name = solvable_lookup_str(s, SOLVABLE_SOURCENAME);
-            if (name == NULL)
-                name = pool_id2str(pool, s->name);
-            if (!g_str_has_prefix(match, name)) // early check
-                continue;
-
-            DnfPackage *pkg = dnf_package_new(sack, id);
-            const char *srcrpm = dnf_package_get_sourcerpm(pkg);
-            if (srcrpm && !strcmp(match, srcrpm))
-                MAPSET(m, id);
-            g_object_unref(pkg);
+        // "name-version-release.arch.rpm", version and release never contain '-'. Try the
+        // name both with and without a release part, a source name is always one of them.
+        std::vector<Id> sourceNames;
+        const char *dash = strrchr(match, '-');
+        for (int i = 0; i < 2 && dash && dash != match; ++i) {
+            Id sourceName = pool_strn2id(pool, match, dash - match, 0);
+            if (sourceName)
+                sourceNames.push_back(sourceName);
+            do {
+                --dash;
+            } while (dash != match && *dash != '-');
+        }
+
+        for (auto sourceName : sourceNames) {
+            auto range = nameIndex->bySourceName(sourceName);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (resultPset->has(it->second))
+                    sourcerpm_match(sack, it->second, match, m);
+            }
+        }
+        for (auto id : nameIndex->getUnindexedSources()) {
+            if (resultPset->has(id))
+                sourcerpm_match(sack, id, match, m);
         }
     }
 }
@@ -1835,48 +1810,37 @@ Query::Impl::filterAdvisory(const Filter & f, Map *m, int keyname)
 {
     Pool *pool = dnf_sack_get_pool(sack);
     std::vector<AdvisoryPkg> pkgs;
-    std::vector<AdvisoryPkg> pkgsSecondRun;
-    Dataiterator di;
-    bool eq;
     auto resultPset = result.get();
+    auto advisoryIndex = dnf_sack_get_advisory_index(sack);
+    AdvisoryIndex::Key key;
 
-    // iterate over advisories
-    dataiterator_init(&di, pool, 0, 0, 0, 0, 0);
-    dataiterator_prepend_keyname(&di, UPDATE_COLLECTION);
-    while (dataiterator_step(&di)) {
-        dataiterator_setpos_parent(&di);
-        Advisory advisory(sack, di.solvid);
-
-        for (auto match_in : f.getMatches()) {
-            const char *match = match_in.str;
-            switch(keyname) {
-                case HY_PKG_ADVISORY:
-                    eq = advisory.matchName(match);
-                    break;
-                case HY_PKG_ADVISORY_BUG:
-                    eq = advisory.matchBug(match);
-                    break;
-                case HY_PKG_ADVISORY_CVE:
-                    eq = advisory.matchCVE(match);
-                    break;
-                case HY_PKG_ADVISORY_TYPE:
-                    eq = advisory.matchKind(match);
-                    break;
-                case HY_PKG_ADVISORY_SEVERITY:
-                    eq = advisory.matchSeverity(match);
-                    break;
-                default:
-                    eq = false;
-            }
-            if (eq) {
-                advisory.getApplicablePackages(pkgs, false);
-                break;
-            }
-        }
-        dataiterator_skip_solvable(&di);
+    switch(keyname) {
+        case HY_PKG_ADVISORY:
+            key = AdvisoryIndex::Key::NAME;
+            break;
+        case HY_PKG_ADVISORY_BUG:
+            key = AdvisoryIndex::Key::BUG;
+            break;
+        case HY_PKG_ADVISORY_CVE:
+            key = AdvisoryIndex::Key::CVE;
+            break;
+        case HY_PKG_ADVISORY_TYPE:
+            key = AdvisoryIndex::Key::TYPE;
+            break;
+        case HY_PKG_ADVISORY_SEVERITY:
+            key = AdvisoryIndex::Key::SEVERITY;
+            break;
+        default:
+            return;
     }
-    dataiterator_free(&di);
-    std::sort(pkgs.begin(), pkgs.end(), advisoryPkgSort);
+
+    Map advisories;
+    map_init(&advisories, pool->nsolvables);
+    for (auto match_in : f.getMatches())
+        advisoryIndex->match(key, match_in.str, &advisories);
+    // sorted by name, arch and evr
+    advisoryIndex->getApplicablePackages(&advisories, pkgs, false);
+    map_free(&advisories);
 
     int cmp_type = f.getCmpType();
 
@@ -2029,6 +1993,7 @@ Query::Impl::filterLatest(const Filter & f, Map *m)
     int keyname = f.getKeyname(); 
     Pool *pool = dnf_sack_get_pool(sack);
     auto resultPset = result.get();
+    auto latestIndex = dnf_sack_get_latest_index(sack);
 
     for (auto match_in : f.getMatches()) {
         int latest = match_in.num;
@@ -2037,23 +2002,12 @@ Query::Impl::filterLatest(const Filter & f, Map *m)
         Queue samename;
 
         queue_init(&samename);
-        Id id = -1;
-        while (true) {
-            id = resultPset->next(id);
-            if (id == -1)
-                break;
-            queue_push(&samename, id);
-        }
-
         if (keyname == HY_PKG_LATEST_PER_ARCH) {
-            solv_sort(samename.elements, samename.count, sizeof(Id),
-                      filter_latest_sortcmp_byarch, pool);
+            latestIndex->order(*resultPset, LatestIndex::Grouping::NAME_ARCH, &samename);
         } else if (keyname == HY_PKG_LATEST_PER_ARCH_BY_PRIORITY) {
-            solv_sort(samename.elements, samename.count, sizeof(Id),
-                      filter_latest_sortcmp_byarch_bypriority, pool);
+            latestIndex->order(*resultPset, LatestIndex::Grouping::NAME_ARCH_PRIORITY, &samename);
         } else {
-            solv_sort(samename.elements, samename.count, sizeof(Id),
-                      filter_latest_sortcmp, pool);
+            latestIndex->order(*resultPset, LatestIndex::Grouping::NAME, &samename);
         }
 
         // Create blocks per name, arch and repo priority
@@ -2101,7 +2055,6 @@ void
 Query::Impl::filterUpdown(const Filter & f, Map *m)
 {
     Pool *pool = dnf_sack_get_pool(sack);
-    auto resultPset = result.get();
 
     dnf_sack_make_provides_ready(sack);
 
@@ -2109,24 +2062,15 @@ Query::Impl::filterUpdown(const Filter & f, Map *m)
         return;
     }
 
+    auto graph = dnf_sack_get_updown_graph(sack);
     for (auto match_in : f.getMatches()) {
         if (match_in.num == 0)
             continue;
-
-        Id id = -1;
-        while (true) {
-            id = resultPset->next(id);
-            if (id == -1)
-                break;
-            Solvable *s = pool_id2solvable(pool, id);
-            if (s->repo == pool->installed)
-                continue;
-            if (f.getKeyname() == HY_PKG_DOWNGRADES) {
-                if (what_downgrades(pool, id) > 0)
-                    MAPSET(m, id);
-            } else if (what_upgrades(pool, id) > 0)
-                MAPSET(m, id);
-        }
+        // apply() intersects m with the result
+        if (f.getKeyname() == HY_PKG_DOWNGRADES)
+            map_or(m, const_cast<Map *>(graph->getDowngrades()));
+        else
+            map_or(m, const_cast<Map *>(graph->getUpgrades()));
     }
 }
 
@@ -2158,6 +2102,7 @@ Query::Impl::filterUpdownByPriority(const Filter & f, Map *m)
             continue;
         }
         std::sort(upgradeCandidates.begin(), upgradeCandidates.end(), NamePrioritySolvableKey);
+        auto upgrades = dnf_sack_get_updown_graph(sack)->getUpgrades();
         Id name = 0;
         int priority = 0;
         for (auto * candidate: upgradeCandidates) {
@@ -2165,12 +2110,12 @@ Query::Impl::filterUpdownByPriority(const Filter & f, Map *m)
                 name = candidate->name;
                 priority = candidate->repo->priority;
                 id = pool_solvable2id(pool, candidate);
-                if (what_upgrades(pool, id) > 0) {
+                if (MAPTST(upgrades, id)) {
                     MAPSET(m, id);
                 }
             } else if (priority == candidate->repo->priority) {
                 id = pool_solvable2id(pool, candidate);
-                if (what_upgrades(pool, id) > 0) {
+                if (MAPTST(upgrades, id)) {
                     MAPSET(m, id);
                 }
             }
@@ -2181,8 +2126,6 @@ Query::Impl::filterUpdownByPriority(const Filter & f, Map *m)
 void
 Query::Impl::filterUpdownAble(const Filter  &f, Map *m)
 {
-    Id p, what;
-    Solvable *s;
     Pool *pool = dnf_sack_get_pool(sack);
 
     dnf_sack_make_provides_ready(sack);
@@ -2190,13 +2133,17 @@ Query::Impl::filterUpdownAble(const Filter  &f, Map *m)
     if (!pool->installed) {
         return;
     }
-    auto resultMap = result->getMap();
+    auto resultMap = result->borrowMap();
+    auto graph = dnf_sack_get_updown_graph(sack);
+    auto & edges = (f.getKeyname() == HY_PKG_DOWNGRADABLE) ? graph->getDowngradeEdges() :
+        graph->getUpgradeEdges();
 
     for (auto match_in : f.getMatches()) {
         if (match_in.num == 0)
             continue;
 
-        FOR_PKG_SOLVABLES(p) {
+        for (auto & edge : edges) {
+            Id p = edge.first;
             if (flags == Query::ExcludeFlags::APPLY_EXCLUDES) {
                 if (pool->considered && !map_tst(pool->considered, p))
                     continue;
@@ -2204,14 +2151,8 @@ Query::Impl::filterUpdownAble(const Filter  &f, Map *m)
                 if (considered_cached && !map_tst(considered_cached, p))
                     continue;
             }
-            s = pool_id2solvable(pool, p);
-            if (s->repo == pool->installed)
-                continue;
-
-            what = (f.getKeyname() == HY_PKG_DOWNGRADABLE) ? what_downgrades(pool, p) :
-                what_upgrades(pool, p);
-            if (what != 0 && map_tst(resultMap, what))
-                map_set(m, what);
+            if (map_tst(resultMap, edge.second))
+                map_set(m, edge.second);
         }
     }
 }
@@ -2227,6 +2168,9 @@ Query::Impl::filterDataiterator(const Filter & f, Map *m)
 
     assert(f.getMatchType() == _HY_STR);
 
+    if (f.getKeyname() == HY_PKG_FILE && filterFileIndex(f, m))
+        return;
+
     for (auto match_in : f.getMatches()) {
         const char *match = match_in.str;
         Id id = -1;
@@ -2244,6 +2188,41 @@ Query::Impl::filterDataiterator(const Filter & f, Map *m)
     }
 }
 
+/**
+* @brief Answer exact file matches from the sack's file index and prefixed globs over large
+* results from a pruned filelist walk
+*
+* @return false when the filter has to be evaluated by the dataiterator instead
+*/
+bool
+Query::Impl::filterFileIndex(const Filter & f, Map *m)
+{
+    Pool *pool = dnf_sack_get_pool(sack);
+    int cmpType = f.getCmpType() & ~HY_NOT;
+    if (cmpType == HY_GLOB) {
+        // the walk visits every filelist, small results are scanned cheaper one by one
+        if (result->size() * 4 < static_cast<size_t>(pool->nsolvables))
+            return false;
+        // patterns without a literal prefix would compose every path of the pool
+        for (auto match_in : f.getMatches()) {
+            if (FileIndex::globPrefix(match_in.str).empty())
+                return false;
+        }
+        for (auto match_in : f.getMatches())
+            FileIndex::matchGlob(pool, match_in.str, m);
+    } else if (cmpType == HY_EQ) {
+        auto fileIndex = dnf_sack_get_file_index(sack);
+        if (!fileIndex)
+            return false;
+        for (auto match_in : f.getMatches())
+            fileIndex->match(match_in.str, m);
+    } else {
+        return false;
+    }
+    map_and(m, result->borrowMap());
+    return true;
+}
+
 int
 Query::Impl::filterUnneededOrSafeToRemove(const Swdb &swdb, bool debug_solver, bool safeToRemove)
 {
@@ -2282,7 +2261,7 @@ Query::Impl::filterUnneededOrSafeToRemove(const Swdb &swdb, bool debug_solver, b
     for (int i = 0; i < que.size(); ++i) {
         MAPSET(&resultInternal, que[i]);
     }
-    map_and(result->getMap(), &resultInternal);
+    map_and(result->borrowMap(), &resultInternal);
     map_free(&resultInternal);
     return 0;
 }
@@ -2313,111 +2292,153 @@ Query::Impl::apply()
     if (!result)
         initResult();
     map_init(&m, pool->nsolvables);
-    map_grow(result->getMap(), pool->nsolvables);
+    map_grow(result->borrowMap(), pool->nsolvables);
+    plan_filters(filters);
+    plan.clear();
+    plan.reserve(filters.size());
+    initialCardinality = result->size();
+    bool resultEmpty = initialCardinality == 0;
     for (auto f : filters) {
-        map_empty(&m);
-        switch (f.getKeyname()) {
-            case HY_PKG:
-                filterPkg(f, &m);
-                break;
-            case HY_PKG_ALL:
-            case HY_PKG_EMPTY:
-                /* used to set query empty by keeping Map m empty */
-                break;
-            case HY_PKG_NAME:
-                filterName(f, &m);
-                break;
-            case HY_PKG_EPOCH:
-                filterEpoch(f, &m);
-                break;
-            case HY_PKG_EVR:
-                filterEvr(f, &m);
-                break;
-            case HY_PKG_NEVRA:
-                filterNevra(f, &m);
-                break;
-            case HY_PKG_VERSION:
-                filterVersion(f, &m);
-                break;
-            case HY_PKG_RELEASE:
-                filterRelease(f, &m);
-                break;
-            case HY_PKG_ARCH:
-                filterArch(f, &m);
-                break;
-            case HY_PKG_SOURCERPM:
-                filterSourcerpm(f, &m);
-                break;
-            case HY_PKG_OBSOLETES:
-                if (f.getMatchType() == _HY_RELDEP)
-                    filterRcoReldep(f, &m);
-                else {
-                    assert(f.getMatchType() == _HY_PKG);
-                    filterObsoletes(f, &m);
-                }
-                break;
-            case HY_PKG_OBSOLETES_BY_PRIORITY:
-                filterObsoletesByPriority(f, &m);
-                break;
-            case HY_PKG_PROVIDES:
-                assert(f.getMatchType() == _HY_RELDEP);
-                filterProvidesReldep(f, &m);
-                break;
-            case HY_PKG_CONFLICTS:
-            case HY_PKG_ENHANCES:
-            case HY_PKG_RECOMMENDS:
-            case HY_PKG_REQUIRES:
-            case HY_PKG_SUGGESTS:
-            case HY_PKG_SUPPLEMENTS:
-                if (f.getMatchType() == _HY_RELDEP)
-                    filterRcoReldep(f, &m);
-                else {
-                    filterDepSolvable(f, &m);
-                }
-                break;
-            case HY_PKG_REPONAME:
-                filterReponame(f, &m);
-                break;
-            case HY_PKG_LOCATION:
-                filterLocation(f, &m);
-                break;
-            case HY_PKG_ADVISORY:
-            case HY_PKG_ADVISORY_BUG:
-            case HY_PKG_ADVISORY_CVE:
-            case HY_PKG_ADVISORY_SEVERITY:
-            case HY_PKG_ADVISORY_TYPE:
-                filterAdvisory(f, &m, f.getKeyname());
-                break;
-            case HY_PKG_LATEST:
-            case HY_PKG_LATEST_PER_ARCH:
-            case HY_PKG_LATEST_PER_ARCH_BY_PRIORITY:
-                filterLatest(f, &m);
-                break;
-            case HY_PKG_DOWNGRADABLE:
-            case HY_PKG_UPGRADABLE:
-                filterUpdownAble(f, &m);
-                break;
-            case HY_PKG_DOWNGRADES:
-            case HY_PKG_UPGRADES:
-                filterUpdown(f, &m);
-                break;
-            case HY_PKG_UPGRADES_BY_PRIORITY:
-                filterUpdownByPriority(f, &m);
-                break;
-            default:
-                filterDataiterator(f, &m);
+        // every filter only narrows the result, nothing can bring packages back
+        if (resultEmpty) {
+            plan.push_back({f, false, 0, 0});
+            continue;
         }
+        auto start = std::chrono::steady_clock::now();
+        map_empty(&m);
+        applyFilter(f, &m);
         if (f.getCmpType() & HY_NOT)
-            map_subtract(result->getMap(), &m);
+            map_subtract(result->borrowMap(), &m);
         else
-            map_and(result->getMap(), &m);
+            map_and(result->borrowMap(), &m);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        auto cardinality = result->size();
+        plan.push_back({f, true, elapsed.count(), cardinality});
+        resultEmpty = cardinality == 0;
     }
     map_free(&m);
+    // most results are a small part of the pool, copies and set operations get cheaper
+    result->compact();
 
     applied = true;
     filters.clear();
 }
 
+void
+Query::Impl::applyFilter(const Filter & f, Map *m)
+{
+    switch (f.getKeyname()) {
+        case HY_PKG:
+            filterPkg(f, m);
+            break;
+        case HY_PKG_ALL:
+        case HY_PKG_EMPTY:
+            /* used to set query empty by keeping Map m empty */
+            break;
+        case HY_PKG_NAME:
+            filterName(f, m);
+            break;
+        case HY_PKG_EPOCH:
+            filterEpoch(f, m);
+            break;
+        case HY_PKG_EVR:
+            filterEvr(f, m);
+            break;
+        case HY_PKG_NEVRA:
+            filterNevra(f, m);
+            break;
+        case HY_PKG_VERSION:
+            filterVersion(f, m);
+            break;
+        case HY_PKG_RELEASE:
+            filterRelease(f, m);
+            break;
+        case HY_PKG_ARCH:
+            filterArch(f, m);
+            break;
+        case HY_PKG_SOURCERPM:
+            filterSourcerpm(f, m);
+            break;
+        case HY_PKG_OBSOLETES:
+            if (f.getMatchType() == _HY_RELDEP)
+                filterRcoReldep(f, m);
+            else {
+                assert(f.getMatchType() == _HY_PKG);
+                filterObsoletes(f, m);
+            }
+            break;
+        case HY_PKG_OBSOLETES_BY_PRIORITY:
+            filterObsoletesByPriority(f, m);
+            break;
+        case HY_PKG_PROVIDES:
+            assert(f.getMatchType() == _HY_RELDEP);
+            filterProvidesReldep(f, m);
+            break;
+        case HY_PKG_CONFLICTS:
+        case HY_PKG_ENHANCES:
+        case HY_PKG_RECOMMENDS:
+        case HY_PKG_REQUIRES:
+        case HY_PKG_SUGGESTS:
+        case HY_PKG_SUPPLEMENTS:
+            if (f.getMatchType() == _HY_RELDEP)
+                filterRcoReldep(f, m);
+            else {
+                filterDepSolvable(f, m);
+            }
+            break;
+        case HY_PKG_REPONAME:
+            filterReponame(f, m);
+            break;
+        case HY_PKG_LOCATION:
+            filterLocation(f, m);
+            break;
+        case HY_PKG_ADVISORY:
+        case HY_PKG_ADVISORY_BUG:
+        case HY_PKG_ADVISORY_CVE:
+        case HY_PKG_ADVISORY_SEVERITY:
+        case HY_PKG_ADVISORY_TYPE:
+            filterAdvisory(f, m, f.getKeyname());
+            break;
+        case HY_PKG_LATEST:
+        case HY_PKG_LATEST_PER_ARCH:
+        case HY_PKG_LATEST_PER_ARCH_BY_PRIORITY:
+            filterLatest(f, m);
+            break;
+        case HY_PKG_DOWNGRADABLE:
+        case HY_PKG_UPGRADABLE:
+            filterUpdownAble(f, m);
+            break;
+        case HY_PKG_DOWNGRADES:
+        case HY_PKG_UPGRADES:
+            filterUpdown(f, m);
+            break;
+        case HY_PKG_UPGRADES_BY_PRIORITY:
+            filterUpdownByPriority(f, m);
+            break;
+        default:
+            filterDataiterator(f, m);
+    }
+}
+
+std::string
+Query::explain()
+{
+    apply();
+    std::ostringstream out;
+    out << "initial: " << pImpl->initialCardinality << " packages\n";
+    unsigned int step = 0;
+    for (const auto & planStep : pImpl->plan) {
+        auto & f = planStep.filter;
+        out << ++step << ". " << filter_keyname2str(f.getKeyname()) << " "
+            << filter_cmp_type2str(f.getCmpType()) << " (" << f.getMatches().size() << " matches): ";
+        if (planStep.evaluated)
+            out << planStep.ms << " ms, " << planStep.cardinality << " packages\n";
+        else
+            out << "skipped, result already empty\n";
+    }
+    return out.str();
+}
+
 GPtrArray *
 Query::run()
 {
@@ -2477,7 +2498,7 @@ Query::filterExtras()
 
     Pool * pool = dnf_sack_get_pool(pImpl->sack);
 
-    auto resultMap = pImpl->result->getMap();
+    auto resultMap = pImpl->result->borrowMap();
     Query query_installed(*this);
     query_installed.installed();
     MAPZERO(resultMap);
@@ -2519,7 +2540,7 @@ Query::filterRecent(const long unsigned int recent_limit)
 {
     apply();
     auto resultPset = pImpl->result.get();
-    auto resultMap = pImpl->result->getMap();
+    auto resultMap = pImpl->result->borrowMap();
 
     Id id = -1;
     while (true) {
@@ -2543,7 +2564,7 @@ Query::filterDuplicated()
 
     installed();
 
-    auto resultMap = pImpl->result->getMap();
+    auto resultMap = pImpl->result->borrowMap();
     hy_query_to_name_ordered_queue(this, &samename);
 
     Solvable *considered, *highest = 0;
@@ -2591,19 +2612,10 @@ Query::getAdvisoryPkgs(int cmpType, std::vector<AdvisoryPkg> & advisoryPkgs)
     auto sack = pImpl->sack;
     Pool *pool = dnf_sack_get_pool(sack);
     std::vector<AdvisoryPkg> pkgs;
-    Dataiterator di;
     auto resultPset = pImpl->result.get();
 
-    // iterate over advisories
-    dataiterator_init(&di, pool, 0, 0, 0, 0, 0);
-    dataiterator_prepend_keyname(&di, UPDATE_COLLECTION);
-    while (dataiterator_step(&di)) {
-        Advisory advisory(sack, di.solvid);
-        advisory.getApplicablePackages(pkgs);
-        dataiterator_skip_solvable(&di);
-    }
-    dataiterator_free(&di);
-    std::sort(pkgs.begin(), pkgs.end(), advisoryPkgSort);
+    // sorted by name, arch and evr
+    dnf_sack_get_advisory_index(sack)->getApplicablePackages(nullptr, pkgs, true);
     // convert nevras (from DnfAdvisoryPkg) to pool ids
     Id id = -1;
     while (true) {
@@ -2689,7 +2701,7 @@ Query::installed()
         }
         break;
     }
-    map_and(queryResult->getMap(), &filterResult);
+    map_and(queryResult->borrowMap(), &filterResult);
     map_free(&filterResult);
 }
 
@@ -2768,34 +2780,342 @@ Query::filterSubject(const char * subject, HyForm * forms, bool icase, bool with
     return {false, std::unique_ptr<Nevra>()};
 }
 
+namespace {
+
+/// One parsed NEVRA form of a subject, collecting the packages it matches
+struct SubjectForm {
+    std::size_t subject;
+    std::size_t order;
+    Nevra nevra;
+    bool nameGlob;
+    Id archId;
+    std::vector<Id> matches;
+};
+
+/// Glob name forms keyed by the literal prefix of the name pattern
+typedef std::vector<std::pair<std::string, std::size_t>> PrefixedForms;
+
+/// Upper bound of the threads probing subjects, whatever the number of cores
+constexpr std::size_t SUBJECT_PROBE_MAX_THREADS = 4;
+/// Probes a thread gets at least, fewer subjects are probed on the calling thread
+constexpr std::size_t SUBJECT_PROBES_PER_THREAD = 8;
+
+/// Fallback probes of a subject none of whose NEVRA forms matched
+struct SubjectProbe {
+    std::size_t subject;
+    DependencySplitter provide;
+    bool provideParsed;
+    std::vector<Id> nevraMatches;
+    /// pool strings matching the glob of the provide name
+    std::vector<Id> provideNames;
+};
+
+bool
+subjectFormNameMatches(Pool * pool, const SubjectForm & form, Id nameId, bool icase)
+{
+    auto & name = form.nevra.getName();
+    if (name.empty() || name == "*")
+        return true;
+    const char * pkgName = pool_id2str(pool, nameId);
+    if (form.nameGlob)
+        return fnmatch(name.c_str(), pkgName, icase ? FNM_CASEFOLD : 0) == 0;
+    if (icase)
+        return strcasecmp(name.c_str(), pkgName) == 0;
+    return pool_str2id(pool, name.c_str(), 0) == nameId;
+}
+
+/// Same checks as the epoch, version, release and arch filters added by Query::addFilter(HyNevra)
+bool
+subjectFormEvrArchMatches(Pool * pool, const SubjectForm & form, Solvable * s)
+{
+    auto & nevra = form.nevra;
+    auto & version = nevra.getVersion();
+    auto & release = nevra.getRelease();
+    auto & arch = nevra.getArch();
+    bool checkVersion = !version.empty() && version != "*";
+    bool checkRelease = !release.empty() && release != "*";
+
+    if (!arch.empty() && arch != "*") {
+        if (hy_is_glob_pattern(arch.c_str())) {
+            if (fnmatch(arch.c_str(), pool_id2str(pool, s->arch), 0) != 0)
+                return false;
+        } else if (form.archId == 0 || form.archId != s->arch) {
+            return false;
+        }
+    }
+    if (nevra.getEpoch() == Nevra::EPOCH_NOT_SET && !checkVersion && !checkRelease)
+        return true;
+    if (s->evr == ID_EMPTY)
+        return false;
+
+    const char * evr = pool_id2str(pool, s->evr);
+    if (nevra.getEpoch() != Nevra::EPOCH_NOT_SET &&
+        pool_get_epoch(pool, evr) != static_cast<unsigned long>(nevra.getEpoch()))
+        return false;
+    if (!checkVersion && !checkRelease)
+        return true;
+
+    char *e, *v, *r;
+    pool_split_evr(pool, evr, &e, &v, &r);
+    if (checkVersion) {
+        if (hy_is_glob_pattern(version.c_str())) {
+            if (fnmatch(version.c_str(), v, 0) != 0)
+                return false;
+        } else {
+            char * vr = pool_tmpjoin(pool, v, "-0", NULL);
+            char * filter_vr = pool_tmpjoin(pool, version.c_str(), "-0", NULL);
+            if (pool_evrcmp_str(pool, vr, filter_vr, EVRCMP_COMPARE) != 0)
+                return false;
+        }
+    }
+    if (checkRelease) {
+        if (hy_is_glob_pattern(release.c_str())) {
+            if (fnmatch(release.c_str(), r, 0) != 0)
+                return false;
+        } else {
+            char * vr = pool_tmpjoin(pool, "0-", r, NULL);
+            char * filter_vr = pool_tmpjoin(pool, "0-", release.c_str(), NULL);
+            if (pool_evrcmp_str(pool, vr, filter_vr, EVRCMP_COMPARE) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+}
+
+std::vector<PackageSet>
+Query::filterSubjects(const std::vector<std::string> & subjects, bool icase, bool with_nevra,
+    bool with_provides, bool with_filenames)
+{
+    apply();
+    Pool * pool = dnf_sack_get_pool(pImpl->sack);
+
+    std::vector<PackageSet> matched;
+    matched.reserve(subjects.size());
+    for (std::size_t i = 0; i < subjects.size(); ++i)
+        matched.emplace_back(pImpl->sack);
+
+    std::vector<SubjectForm> forms;
+    std::vector<std::vector<std::size_t>> subjectForms(subjects.size());
+    std::unordered_map<Id, std::vector<std::size_t>> exactNames;
+    PrefixedForms prefixedForms;
+    std::vector<std::size_t> prefixLengths;
+    std::vector<std::size_t> scannedForms;
+
+    // parse every subject once and sort its forms into lookup buckets by the kind of name match
+    for (std::size_t i = 0; with_nevra && i < subjects.size(); ++i) {
+        for (std::size_t j = 0; HY_FORMS_MOST_SPEC[j] != _HY_FORM_STOP_; ++j) {
+            Nevra nevra;
+            if (!nevra.parse(subjects[i].c_str(), HY_FORMS_MOST_SPEC[j]))
+                continue;
+            auto idx = forms.size();
+            auto & name = nevra.getName();
+            bool nameGlob = hy_is_glob_pattern(name.c_str());
+            Id archId = nevra.getArch().empty() ? 0 : pool_str2id(pool, nevra.getArch().c_str(), 0);
+            if (name.empty() || name == "*" || icase) {
+                scannedForms.push_back(idx);
+            } else if (nameGlob) {
+                auto prefix = name.substr(0, name.find_first_of("*?[\\"));
+                prefixLengths.push_back(prefix.size());
+                prefixedForms.emplace_back(std::move(prefix), idx);
+            } else {
+                Id nameId = pool_str2id(pool, name.c_str(), 0);
+                if (nameId == 0)
+                    continue;
+                exactNames[nameId].push_back(idx);
+            }
+            subjectForms[i].push_back(idx);
+            forms.push_back({i, subjectForms[i].size() - 1, std::move(nevra), nameGlob, archId, {}});
+        }
+    }
+    std::sort(prefixedForms.begin(), prefixedForms.end());
+    std::sort(prefixLengths.begin(), prefixLengths.end());
+    prefixLengths.erase(std::unique(prefixLengths.begin(), prefixLengths.end()), prefixLengths.end());
+
+    // only the first form of a subject that matches anything is used, later ones need no evaluation
+    auto tryForm = [&](std::size_t idx, Id id, Solvable * s, bool checkName) {
+        auto & form = forms[idx];
+        auto & sameSubject = subjectForms[form.subject];
+        for (std::size_t k = 0; k < form.order; ++k) {
+            if (!forms[sameSubject[k]].matches.empty())
+                return;
+        }
+        if (checkName && !subjectFormNameMatches(pool, form, s->name, icase))
+            return;
+        if (subjectFormEvrArchMatches(pool, form, s))
+            form.matches.push_back(id);
+    };
+
+    auto resultPset = pImpl->result.get();
+    if (!exactNames.empty()) {
+        auto nameIndex = dnf_sack_get_name_index(pImpl->sack);
+        for (const auto & exact : exactNames) {
+            auto range = nameIndex->byName(exact.first);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (!resultPset->has(it->second))
+                    continue;
+                Solvable * s = pool_id2solvable(pool, it->second);
+                for (auto idx : exact.second)
+                    tryForm(idx, it->second, s, false);
+            }
+        }
+    }
+
+    // the remaining forms can not be narrowed down by the name index
+    bool scan = !prefixedForms.empty() || !scannedForms.empty();
+    Id id = -1;
+    while (scan && (id = resultPset->next(id)) != -1) {
+        Solvable * s = pool_id2solvable(pool, id);
+        if (!prefixedForms.empty()) {
+            const char * name = pool_id2str(pool, s->name);
+            auto nameLen = strlen(name);
+            for (auto len : prefixLengths) {
+                if (len > nameLen)
+                    break;
+                auto low = std::lower_bound(prefixedForms.begin(), prefixedForms.end(), len,
+                    [name](const PrefixedForms::value_type & item, std::size_t prefixLen)
+                    { return item.first.compare(0, std::string::npos, name, prefixLen) < 0; });
+                for (; low != prefixedForms.end() &&
+                       low->first.compare(0, std::string::npos, name, len) == 0; ++low) {
+                    tryForm(low->second, id, s, true);
+                }
+            }
+        }
+        for (auto idx : scannedForms)
+            tryForm(idx, id, s, true);
+    }
+
+    std::vector<SubjectProbe> probes;
+    for (std::size_t i = 0; i < subjects.size(); ++i) {
+        bool found = false;
+        for (auto idx : subjectForms[i]) {
+            if (forms[idx].matches.empty())
+                continue;
+            for (auto match : forms[idx].matches)
+                matched[i].set(match);
+            found = true;
+            break;
+        }
+        if (found)
+            continue;
+        probes.push_back({i, {}, false, {}, {}});
+        if (with_provides)
+            probes.back().provideParsed = probes.back().provide.parse(subjects[i].c_str());
+    }
+    if (probes.empty())
+        return matched;
+
+    // The workers below only match strings of the pool. Everything that may create pool strings
+    // or relations, and the filelist lookups, which page in repo data, stay on this thread.
+    Id nstrings = pool->ss.nstrings;
+
+    auto probeSubject = [&](SubjectProbe & probe) {
+        const char * subject = subjects[probe.subject].c_str();
+        if (with_nevra && !strpbrk(subject, "(/=<> ")) {
+            bool withEpoch = strchr(subject, ':') != NULL;
+            std::string nevra;
+            for (Id id = resultPset->next(-1); id != -1; id = resultPset->next(id)) {
+                solvable_epoch_optional_2str(pool, pool_id2solvable(pool, id), withEpoch, nevra);
+                if (fnmatch(subject, nevra.c_str(), 0) == 0)
+                    probe.nevraMatches.push_back(id);
+            }
+            if (!probe.nevraMatches.empty())
+                return;
+        }
+        // the provides whose names match a glob are resolved back on the calling thread
+        if (probe.provideParsed && hy_is_glob_pattern(probe.provide.getNameCStr())) {
+            const char * pattern = probe.provide.getNameCStr();
+            for (Id str = 1; str < nstrings; ++str) {
+                if (fnmatch(pattern, pool_id2str(pool, str), 0) == 0)
+                    probe.provideNames.push_back(str);
+            }
+        }
+    };
+
+    std::atomic<std::size_t> nextProbe{0};
+    auto worker = [&]() {
+        for (std::size_t i = nextProbe++; i < probes.size(); i = nextProbe++)
+            probeSubject(probes[i]);
+    };
+    std::size_t nthreads = std::min<std::size_t>(SUBJECT_PROBE_MAX_THREADS,
+        std::max(1u, std::thread::hardware_concurrency()));
+    nthreads = std::min(nthreads, probes.size() / SUBJECT_PROBES_PER_THREAD);
+    if (nthreads <= 1) {
+        worker();
+    } else {
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < nthreads; ++i)
+            threads.emplace_back(worker);
+        for (auto & thread : threads)
+            thread.join();
+    }
+
+    // keep the order of filterSubject(): NEVRA glob, then provides, then files
+    for (auto & probe : probes) {
+        auto & subjectMatched = matched[probe.subject];
+        if (!probe.nevraMatches.empty()) {
+            for (auto match : probe.nevraMatches)
+                subjectMatched.set(match);
+            continue;
+        }
+        if (probe.provideParsed) {
+            const char * name = probe.provide.getNameCStr();
+            if (!hy_is_glob_pattern(name)) {
+                Id nameId = pool_str2id(pool, name, 0);
+                if (nameId != 0)
+                    probe.provideNames.push_back(nameId);
+            }
+            std::vector<Id> reldeps;
+            for (auto nameId : probe.provideNames) {
+                Dependency reldep(pImpl->sack, pool_id2str(pool, nameId),
+                    probe.provide.getEVRCStr(), probe.provide.getCmpType());
+                reldeps.push_back(reldep.getId());
+            }
+            if (!reldeps.empty())
+                dnf_sack_make_provides_ready(pImpl->sack);
+            bool found = false;
+            for (auto reldep : reldeps) {
+                Id p, pp;
+                FOR_PROVIDES(p, pp, reldep) {
+                    if (resultPset->has(p)) {
+                        subjectMatched.set(p);
+                        found = true;
+                    }
+                }
+            }
+            if (found)
+                continue;
+        }
+        const char * subject = subjects[probe.subject].c_str();
+        if (with_filenames && hy_is_file_pattern(subject)) {
+            Map files;
+            map_init(&files, pool->nsolvables);
+            FileIndex::matchGlob(pool, subject, &files);
+            for (Id id = resultPset->next(-1); id != -1; id = resultPset->next(id)) {
+                if (MAPTST(&files, id))
+                    subjectMatched.set(id);
+            }
+            map_free(&files);
+        }
+    }
+    return matched;
+}
+
 void
 hy_query_to_name_ordered_queue(HyQuery query, IdQueue * samename)
 {
     hy_query_apply(query);
-    Pool *pool = dnf_sack_get_pool(query->getSack());
-
-    const auto result = query->getResult();
-    for (int i = 1; i < pool->nsolvables; ++i)
-        if (MAPTST(result, i))
-            samename->pushBack(i);
-
-    solv_sort(samename->data(), samename->size(), sizeof(Id), filter_latest_sortcmp,
-        pool);
+    dnf_sack_get_latest_index(query->getSack())->order(
+        *query->getResultPset(), LatestIndex::Grouping::NAME, samename->getQueue());
 }
 
 void
 hy_query_to_name_arch_ordered_queue(HyQuery query, IdQueue * samename)
 {
     hy_query_apply(query);
-    Pool *pool = dnf_sack_get_pool(query->getSack());
-
-    const auto result = query->getResult();
-    for (int i = 1; i < pool->nsolvables; ++i)
-        if (MAPTST(result, i))
-            samename->pushBack(i);
-
-    solv_sort(samename->data(), samename->size(), sizeof(Id),
-        filter_latest_sortcmp_byarch, pool);
+    dnf_sack_get_latest_index(query->getSack())->order(
+        *query->getResultPset(), LatestIndex::Grouping::NAME_ARCH, samename->getQueue());
 }
 
 }
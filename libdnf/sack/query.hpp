@@ -32,8 +32,10 @@
 #include "../transaction/Swdb.hpp"
 #include "../dnf-types.h"
 #include "advisorypkg.hpp"
+#include "packageset.hpp"
 
 #include <set>
+#include <string>
 #include <utility>
 
 namespace libdnf {
@@ -125,6 +127,18 @@ public:
     int addFilter(HyNevra nevra, bool icase);
     void apply();
 
+    /**
+    * @brief Applies Query and describes how its filters were evaluated
+    *
+    * Filters are run cheapest first, apart from those that depend on the packages already in
+    * the result (latest, by-priority and advisory filters), which keep their position. Every
+    * line reports one filter in execution order with the time spent on it and the number of
+    * packages left afterwards. Filters skipped because the result was already empty are marked.
+    *
+    * @return std::string
+    */
+    std::string explain();
+
     /**
     * @brief Applies Query and returns DnfPackages in GPtrArray
     *
@@ -215,6 +229,22 @@ public:
     */
     std::pair<bool, std::unique_ptr<Nevra>> filterSubject(const char * subject, HyForm * forms,
         bool icase, bool with_nevra, bool with_provides, bool with_filenames);
+
+    /**
+    * @brief Match many subjects against the query at once
+    *
+    * Each subject is matched as filterSubject(subject, nullptr, icase, with_nevra, with_provides,
+    * with_filenames) would match it on a copy of this query, but the NEVRA forms of all subjects
+    * are parsed up front, exact names are looked up in the sack's name index and the other forms
+    * are evaluated in a single pass over the query result. The NEVRA glob, provides and file
+    * fallbacks of the subjects left unmatched are probed in parallel threads. The query itself
+    * is not modified.
+    *
+    * @return std::vector<PackageSet> Packages matched by each subject, in the order of subjects.
+    *         The set is empty when the subject matched nothing.
+    */
+    std::vector<PackageSet> filterSubjects(const std::vector<std::string> & subjects, bool icase,
+        bool with_nevra, bool with_provides, bool with_filenames);
 private:
     class Impl;
     std::unique_ptr<Impl> pImpl;
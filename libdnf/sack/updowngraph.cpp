@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <assert.h>
+
+#include <solv/repo.h>
+
+#include "updowngraph.hpp"
+#include "../hy-iutil-private.hpp"
+
+namespace libdnf {
+
+UpdownGraph::UpdownGraph(Pool * pool)
+: nsolvables(pool->nsolvables), nrepos(pool->nrepos), installed(pool->installed)
+{
+    Id p;
+    Solvable *s;
+
+    assert(pool->installed);
+    map_init(&upgrades, pool->nsolvables);
+    map_init(&downgrades, pool->nsolvables);
+
+    // only names with an installed package can upgrade or downgrade anything
+    Map installedNames;
+    map_init(&installedNames, pool->ss.nstrings);
+    FOR_REPO_SOLVABLES(pool->installed, p, s)
+        MAPSET(&installedNames, s->name);
+
+    FOR_PKG_SOLVABLES(p) {
+        s = pool_id2solvable(pool, p);
+        if (s->repo == pool->installed || !MAPTST(&installedNames, s->name))
+            continue;
+        Id what = what_upgrades(pool, p);
+        if (what) {
+            MAPSET(&upgrades, p);
+            upgradeEdges.emplace_back(p, what);
+        }
+        what = what_downgrades(pool, p);
+        if (what) {
+            MAPSET(&downgrades, p);
+            downgradeEdges.emplace_back(p, what);
+        }
+    }
+    map_free(&installedNames);
+}
+
+UpdownGraph::~UpdownGraph()
+{
+    map_free(&upgrades);
+    map_free(&downgrades);
+}
+
+}
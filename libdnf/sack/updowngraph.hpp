@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2023 Red Hat, Inc.
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __UPDOWN_GRAPH_HPP
+#define __UPDOWN_GRAPH_HPP
+
+#include <utility>
+#include <vector>
+
+#include <solv/bitmap.h>
+#include <solv/pool.h>
+
+namespace libdnf {
+
+/**
+* @brief Which available packages upgrade or downgrade an installed package, and which one.
+*
+* Built in one pass over the pool with what_upgrades() and what_downgrades(), so it needs the
+* pool's whatprovides and an installed repo. Excludes are not taken into account; callers
+* apply the considered map to the result.
+*/
+class UpdownGraph {
+public:
+    typedef std::vector<std::pair<Id, Id>> Edges;
+
+    explicit UpdownGraph(Pool * pool);
+    ~UpdownGraph();
+    UpdownGraph(const UpdownGraph &) = delete;
+    UpdownGraph & operator=(const UpdownGraph &) = delete;
+
+    /**
+    * @brief Available packages that upgrade some installed package
+    */
+    const Map * getUpgrades() const noexcept { return &upgrades; }
+
+    /**
+    * @brief Available packages that downgrade some installed package
+    */
+    const Map * getDowngrades() const noexcept { return &downgrades; }
+
+    /**
+    * @brief (available, installed package it upgrades) pairs in increasing available order
+    */
+    const Edges & getUpgradeEdges() const noexcept { return upgradeEdges; }
+
+    /**
+    * @brief (available, installed package it downgrades) pairs in increasing available order
+    */
+    const Edges & getDowngradeEdges() const noexcept { return downgradeEdges; }
+
+    /**
+    * @brief Returns false once repos or solvables were added to the pool behind the graph's back
+    */
+    bool isCurrent(const Pool * pool) const noexcept
+    {
+        return pool->nsolvables == nsolvables && pool->nrepos == nrepos &&
+            pool->installed == installed;
+    }
+
+private:
+    Map upgrades;
+    Map downgrades;
+    Edges upgradeEdges;
+    Edges downgradeEdges;
+    int nsolvables;
+    int nrepos;
+    const Repo * installed;
+};
+
+}
+
+#endif /* __UPDOWN_GRAPH_HPP */
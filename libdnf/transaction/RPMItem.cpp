@@ -339,6 +339,48 @@ RPMItem::resolveTransactionItemReason(SQLite3Ptr conn,
     return TransactionItemReason::UNKNOWN;
 }
 
+std::map< std::pair< std::string, std::string >, TransactionItemReason >
+RPMItem::resolveTransactionItemReasons(SQLite3Ptr conn)
+{
+    // SQLite takes the bare columns of an aggregate query from the row holding the MAX(),
+    // which gives the latest transaction item of every (name, arch) pair like the
+    // ORDER BY ... LIMIT 1 in resolveTransactionItemReason() does for a single one
+    const char *sql = R"**(
+        SELECT
+            i.name as name,
+            i.arch as arch,
+            ti.action as action,
+            ti.reason as reason,
+            MAX(ti.trans_id) as trans_id
+        FROM
+            trans_item ti
+        JOIN
+            trans t ON ti.trans_id = t.id
+        JOIN
+            rpm i USING (item_id)
+        WHERE
+            t.state = 1
+            /* see comment in TransactionItem.hpp - TransactionItemAction */
+            AND ti.action not in (3, 5, 7, 10)
+        GROUP BY
+            i.name,
+            i.arch
+    )**";
+
+    std::map< std::pair< std::string, std::string >, TransactionItemReason > result;
+    SQLite3::Query query(*conn, sql);
+    while (query.step() == SQLite3::Statement::StepResult::ROW) {
+        auto action = static_cast< TransactionItemAction >(query.get< int64_t >("action"));
+        auto reason = static_cast< TransactionItemReason >(query.get< int64_t >("reason"));
+        if (action == TransactionItemAction::REMOVE) {
+            reason = TransactionItemReason::UNKNOWN;
+        }
+        result.emplace(std::make_pair(query.get< std::string >("name"), query.get< std::string >("arch")),
+                       reason);
+    }
+    return result;
+}
+
 /**
  * Compare RPM packages
  * This method doesn't care about compare package names
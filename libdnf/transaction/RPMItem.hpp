@@ -21,7 +21,9 @@
 #ifndef LIBDNF_TRANSACTION_RPMITEM_HPP
 #define LIBDNF_TRANSACTION_RPMITEM_HPP
 
+#include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 
 namespace libdnf {
@@ -69,6 +71,10 @@ public:
                                                               const std::string &name,
                                                               const std::string &arch,
                                                               int64_t maxTransactionId);
+    /// Resolve reasons of all (name, arch) pairs found in the history in a single query.
+    /// Pairs without any history are missing in the result, their reason is UNKNOWN.
+    static std::map< std::pair< std::string, std::string >, TransactionItemReason >
+    resolveTransactionItemReasons(SQLite3Ptr conn);
 
     bool operator<(const RPMItem &other) const;
 
@@ -40,6 +40,9 @@
 
 namespace libdnf {
 
+constexpr std::size_t Swdb::writeBatchSize;
+constexpr std::chrono::milliseconds Swdb::writeBatchInterval;
+
 Swdb::Swdb(SQLite3Ptr conn)
   : conn{conn}
   , autoClose(true)
@@ -159,6 +162,11 @@ Swdb::closeDatabase()
 
 Swdb::~Swdb()
 {
+    if (transactionInProgress && conn->isOpened()) {
+        try {
+            flush();
+        } catch(const std::exception &){}
+    }
     if (autoClose) {
         try {
             closeDatabase();
@@ -174,6 +182,9 @@ Swdb::initTransaction()
     }
     transactionInProgress = std::make_shared< swdb_private::Transaction >(conn);
     itemsInProgress.clear();
+    pendingStates.clear();
+    pendingConsoleOutput.clear();
+    lastFlush = std::chrono::steady_clock::now();
 }
 
 int64_t
@@ -193,7 +204,7 @@ Swdb::beginTransaction(int64_t dtBegin,
     transactionInProgress->setCmdline(cmdline);
     transactionInProgress->setUserId(userId);
     transactionInProgress->setComment(comment);
-    transactionInProgress->begin();
+    runInBatch([this]() { transactionInProgress->begin(); });
 
     // save rpm items to map to resolve RPM callbacks
     for (auto item : transactionInProgress->getItems()) {
@@ -216,7 +227,10 @@ Swdb::endTransaction(int64_t dtEnd, std::string rpmdbVersionEnd, TransactionStat
     }
     transactionInProgress->setDtEnd(dtEnd);
     transactionInProgress->setRpmdbVersionEnd(rpmdbVersionEnd);
-    transactionInProgress->finish(state);
+    runInBatch([this, state]() {
+        flush();
+        transactionInProgress->finish(state);
+    });
     return transactionInProgress->getId();
 }
 
@@ -226,6 +240,7 @@ Swdb::closeTransaction()
     if (!transactionInProgress) {
         throw std::logic_error(_("Not in progress"));
     }
+    flush();
     int64_t result = transactionInProgress->getId();
     transactionInProgress = std::unique_ptr< swdb_private::Transaction >(nullptr);
     itemsInProgress.clear();
@@ -255,7 +270,65 @@ Swdb::setItemDone(const std::string &nevra)
     }
     auto item = itemsInProgress[nevra];
     item->setState(TransactionItemState::DONE);
-    item->saveState();
+    pendingStates.push_back(item);
+    flushIfDue();
+}
+
+/**
+ * Run the writes in one database transaction, unless the caller already opened one.
+ * Writes that succeeded before an exception are committed, as they would have been
+ * one by one.
+ */
+void
+Swdb::runInBatch(const std::function< void() > &writes)
+{
+    if (conn->inTransaction()) {
+        writes();
+        return;
+    }
+    conn->exec("BEGIN");
+    try {
+        writes();
+    } catch (...) {
+        try {
+            conn->exec("COMMIT");
+        } catch (const SQLite3::Error &) {
+            conn->exec("ROLLBACK");
+        }
+        throw;
+    }
+    conn->exec("COMMIT");
+}
+
+void
+Swdb::flush()
+{
+    lastFlush = std::chrono::steady_clock::now();
+    if (pendingStates.empty() && pendingConsoleOutput.empty()) {
+        return;
+    }
+    // take the buffers first, a failed batch must not be written twice
+    std::vector< TransactionItemPtr > states;
+    std::vector< std::pair< int, std::string > > consoleOutput;
+    states.swap(pendingStates);
+    consoleOutput.swap(pendingConsoleOutput);
+    runInBatch([this, &states, &consoleOutput]() {
+        for (auto & item : states) {
+            item->saveState();
+        }
+        for (auto & line : consoleOutput) {
+            transactionInProgress->addConsoleOutputLine(line.first, line.second);
+        }
+    });
+}
+
+void
+Swdb::flushIfDue()
+{
+    if (pendingStates.size() + pendingConsoleOutput.size() >= writeBatchSize ||
+        std::chrono::steady_clock::now() - lastFlush >= writeBatchInterval) {
+        flush();
+    }
 }
 
 TransactionItemReason
@@ -392,7 +465,12 @@ Swdb::addConsoleOutputLine(int fileDescriptor, std::string line)
     if (!transactionInProgress) {
         throw std::logic_error(_("Not in progress"));
     }
-    transactionInProgress->addConsoleOutputLine(fileDescriptor, line);
+    // the transaction has to be saved already, fail now rather than at the flush
+    if (!transactionInProgress->getId()) {
+        throw std::runtime_error(_("Can't add console output to unsaved transaction"));
+    }
+    pendingConsoleOutput.emplace_back(fileDescriptor, std::move(line));
+    flushIfDue();
 }
 
 TransactionItemPtr
@@ -596,6 +674,7 @@ void
 Swdb::filterUserinstalled(PackageSet & installed) const
 {
     Pool * pool = dnf_sack_get_pool(installed.getSack());
+    auto reasons = RPMItem::resolveTransactionItemReasons(conn);
 
     // iterate over solvables
     Id id = -1;
@@ -605,10 +684,13 @@ Swdb::filterUserinstalled(PackageSet & installed) const
         const char *name = pool_id2str(pool, s->name);
         const char *arch = pool_id2str(pool, s->arch);
 
-        auto reason = RPMItem::resolveTransactionItemReason(conn, name, arch, -1);
+        auto it = reasons.find(std::make_pair(std::string(name), std::string(arch)));
+        if (it == reasons.end()) {
+            continue;
+        }
         // if not dep or weak, than consider it user installed
-        if (reason == TransactionItemReason::DEPENDENCY ||
-            reason == TransactionItemReason::WEAK_DEPENDENCY) {
+        if (it->second == TransactionItemReason::DEPENDENCY ||
+            it->second == TransactionItemReason::WEAK_DEPENDENCY) {
             installed.remove(id);
         }
     }
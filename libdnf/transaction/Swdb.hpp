@@ -21,6 +21,8 @@
 #ifndef LIBDNF_TRANSACTION_SWDB_HPP
 #define LIBDNF_TRANSACTION_SWDB_HPP
 
+#include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <solv/pooltypes.h>
@@ -89,6 +91,26 @@ public:
     // TODO: remove; TransactionItem states are saved on transaction save
     void setItemDone(const std::string &nevra);
 
+    /**
+    * @brief Write buffered item states and console output lines to the database
+    *
+    * setItemDone() and addConsoleOutputLine() only buffer their writes. The buffer is
+    * written in a single database transaction once it holds writeBatchSize entries, once
+    * writeBatchInterval has passed since the last write, and always in endTransaction()
+    * and closeTransaction().
+    *
+    * Crash consistency: every batch is committed atomically, so the database never holds
+    * a partially written batch. If the process dies, the buffered writes that were not
+    * flushed yet are lost. The affected items then keep the state stored by
+    * beginTransaction() and the transaction stays unfinished, which is the same outcome
+    * as a crash before the items were marked done. Queries on the database made before
+    * a flush do not see the buffered writes either. The in-memory items are always up
+    * to date.
+    */
+    void flush();
+    static constexpr std::size_t writeBatchSize = 256;
+    static constexpr std::chrono::milliseconds writeBatchInterval{2000};
+
     // Item: constructors
     RPMItemPtr createRPMItem();
     CompsGroupItemPtr createCompsGroupItem();
@@ -131,6 +153,12 @@ protected:
     std::map< std::string, TransactionItemPtr > itemsInProgress;
 
 private:
+    void runInBatch(const std::function< void() > &writes);
+    void flushIfDue();
+
+    std::vector< TransactionItemPtr > pendingStates;
+    std::vector< std::pair< int, std::string > > pendingConsoleOutput;
+    std::chrono::steady_clock::time_point lastFlush;
 };
 
 } // namespace libdnf
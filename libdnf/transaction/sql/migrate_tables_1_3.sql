@@ -0,0 +1,10 @@
+R"**(
+BEGIN TRANSACTION;
+    /* speed up resolving reasons of installed packages by name and arch */
+    CREATE INDEX IF NOT EXISTS rpm_name_arch ON rpm(name, arch);
+    CREATE INDEX IF NOT EXISTS trans_item_item_id_trans_id ON trans_item(item_id, trans_id);
+    UPDATE config
+        SET value = '1.3'
+        WHERE key = 'version';
+COMMIT;
+)**"
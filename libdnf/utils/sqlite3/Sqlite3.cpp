@@ -21,6 +21,8 @@
 
 #include "Sqlite3.hpp"
 
+constexpr std::size_t SQLite3::statementCacheSize;
+
 void
 SQLite3::open()
 {
@@ -53,12 +55,15 @@ SQLite3::close()
 {
     if (db == nullptr)
         return;
+    clearStatementCache();
     auto result = sqlite3_close(db);
     if (result == SQLITE_BUSY) {
+        // this finalizes the borrowed statements too, their owners must not touch them again
         sqlite3_stmt *res;
         while ((res = sqlite3_next_stmt(db, nullptr))) {
             sqlite3_finalize(res);
         }
+        ++generation;
         result = sqlite3_close(db);
     }
     if (result != SQLITE_OK) {
@@ -120,3 +125,58 @@ SQLite3::restore(const std::string &inputFile)
         throw Error(*this, result, "Database restore failed");
     }
 }
+
+sqlite3_stmt *
+SQLite3::acquireStatement(const std::string &sql)
+{
+    sqlite3_stmt *stmt;
+
+    auto it = statementCacheIndex.find(sql);
+    if (it != statementCacheIndex.end()) {
+        // a borrowed statement is not in the cache, the same SQL may be in use twice
+        stmt = it->second->second;
+        statementCache.erase(it->second);
+        statementCacheIndex.erase(it);
+        return stmt;
+    }
+
+    auto result = sqlite3_prepare_v2(db, sql.c_str(), sql.length() + 1, &stmt, nullptr);
+    if (result != SQLITE_OK)
+        throw Error(*this, result, "Creating statement failed");
+    return stmt;
+}
+
+void
+SQLite3::releaseStatement(const std::string &sql, sqlite3_stmt *stmt, std::uint64_t stmtGeneration)
+{
+    // the connection was closed while the statement was borrowed, close() finalized it
+    if (stmtGeneration != generation)
+        return;
+
+    // leave the statement ready for the next user and release its locks
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    if (statementCacheIndex.count(sql) != 0) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    statementCache.emplace_front(sql, stmt);
+    statementCacheIndex[sql] = statementCache.begin();
+    if (statementCache.size() > statementCacheSize) {
+        auto & oldest = statementCache.back();
+        statementCacheIndex.erase(oldest.first);
+        sqlite3_finalize(oldest.second);
+        statementCache.pop_back();
+    }
+}
+
+void
+SQLite3::clearStatementCache()
+{
+    for (auto & cached : statementCache) {
+        sqlite3_finalize(cached.second);
+    }
+    statementCache.clear();
+    statementCacheIndex.clear();
+}
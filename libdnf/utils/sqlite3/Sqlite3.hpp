@@ -28,10 +28,13 @@
 #include <sqlite3.h>
 
 #include <cstdint>
+#include <list>
 #include <map>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 class SQLite3 {
@@ -75,20 +78,24 @@ public:
         Statement(const Statement &) = delete;
         Statement &operator=(const Statement &) = delete;
 
+        /**
+         * The statement is borrowed from the prepared statement cache of the connection
+         * when the same SQL was used before, it is returned there on destruction.
+         */
         Statement(SQLite3 &db, const char *sql)
           : db(db)
+          , sql(sql)
+          , generation(db.generation)
         {
-            auto result = sqlite3_prepare_v2(db.db, sql, -1, &stmt, nullptr);
-            if (result != SQLITE_OK)
-                throw SQLite3::Error(db, result, "Creating statement failed");
+            stmt = db.acquireStatement(this->sql);
         };
 
         Statement(SQLite3 &db, const std::string &sql)
           : db(db)
+          , sql(sql)
+          , generation(db.generation)
         {
-            auto result = sqlite3_prepare_v2(db.db, sql.c_str(), sql.length() + 1, &stmt, nullptr);
-            if (result != SQLITE_OK)
-                throw SQLite3::Error(db, result, "Creating statement failed");
+            stmt = db.acquireStatement(this->sql);
         };
 
         void bind(int pos, int val)
@@ -235,7 +242,7 @@ public:
         ~Statement()
         {
             freeExpandedSql();
-            sqlite3_finalize(stmt);
+            db.releaseStatement(sql, stmt, generation);
         };
 
     protected:
@@ -278,6 +285,9 @@ public:
         }
 
         SQLite3 &db;
+        std::string sql;
+        /// the connection the statement was prepared on, see SQLite3::generation
+        std::uint64_t generation;
         sqlite3_stmt *stmt;
         char *expandSql{nullptr};
     };
@@ -352,6 +362,9 @@ public:
 
     int changes() { return sqlite3_changes(db); }
 
+    /// true while an explicit BEGIN is open on the connection
+    bool inTransaction() { return sqlite3_get_autocommit(db) == 0; }
+
     int64_t lastInsertRowID() { return sqlite3_last_insert_rowid(db); }
 
     std::string getError() const { return sqlite3_errmsg(db); }
@@ -359,10 +372,25 @@ public:
     void backup(const std::string &outputFile);
     void restore(const std::string &inputFile);
 
+    /// number of idle prepared statements kept per connection
+    static constexpr std::size_t statementCacheSize = 64;
+
 protected:
     std::string path;
 
     sqlite3 *db;
+
+private:
+    sqlite3_stmt *acquireStatement(const std::string &sql);
+    void releaseStatement(const std::string &sql, sqlite3_stmt *stmt, std::uint64_t stmtGeneration);
+    void clearStatementCache();
+
+    /// bumped by close(), statements of an older generation were finalized by it
+    std::uint64_t generation{0};
+
+    /// idle statements, most recently used first
+    std::list< std::pair< std::string, sqlite3_stmt * > > statementCache;
+    std::unordered_map< std::string, decltype(statementCache)::iterator > statementCacheIndex;
 };
 
 typedef std::shared_ptr< SQLite3 > SQLite3Ptr;
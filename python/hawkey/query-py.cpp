@@ -843,8 +843,7 @@ query_contains(PyObject *self, PyObject *pypkg) try
 
     if (pkg) {
         Id id = dnf_package_get_id(pkg);
-        q->apply();
-        if (MAPTST(q->getResult(), id))
+        if (q->getResultPset()->has(id))
             return 1;
     }
     return 0;
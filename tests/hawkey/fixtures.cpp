@@ -161,6 +161,13 @@ fixture_with_vendor(void)
     fail_if(setup_with(sack, HY_SYSTEM_REPO_NAME, "vendor", NULL));
 }
 
+void
+fixture_with_weak(void)
+{
+    DnfSack *sack = create_ut_sack();
+    fail_if(setup_with(sack, "@System-weak", "weak", NULL));
+}
+
 void
 fixture_all(void)
 {
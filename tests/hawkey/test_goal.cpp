@@ -19,6 +19,7 @@
  */
 
 #include "libdnf/goal/Goal.hpp"
+#include "libdnf/goal/GoalSession.hpp"
 #include "libdnf/dnf-types.h"
 #include "libdnf/hy-goal-private.hpp"
 #include "libdnf/hy-iutil.h"
@@ -32,6 +33,9 @@
 #include "libdnf/hy-selector.h"
 #include "libdnf/hy-util-private.hpp"
 #include "libdnf/sack/packageset.hpp"
+#include "libdnf/sack/query.hpp"
+#include "libdnf/repo/solvable/Dependency.hpp"
+#include "libdnf/repo/solvable/DependencyContainer.hpp"
 
 #include "fixtures.h"
 #include "testsys.h"
@@ -40,6 +44,9 @@
 #include <check.h>
 #include <glib.h>
 #include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
 #include <vector>
 
 static DnfPackage *
@@ -177,6 +184,47 @@ START_TEST(test_goal_install)
 }
 END_TEST
 
+START_TEST(test_goal_reset)
+{
+    DnfPackage *pkg = get_latest_pkg(test_globals.sack, "walrus");
+    HyGoal goal = hy_goal_create(test_globals.sack);
+    fail_if(hy_goal_install(goal, pkg));
+    fail_if(hy_goal_run_flags(goal, DNF_NONE));
+    assert_iueo(goal, 2, 0, 0, 0);
+
+    // the same goal object is usable again, without the old requests
+    goal->reset();
+    fail_if(hy_goal_has_actions(goal, DNF_INSTALL));
+    fail_unless(goal->jobLength() == 0);
+    fail_if(hy_goal_install(goal, pkg));
+    fail_if(hy_goal_run_flags(goal, DNF_NONE));
+    assert_iueo(goal, 2, 0, 0, 0);
+    g_object_unref(pkg);
+    hy_goal_free(goal);
+}
+END_TEST
+
+START_TEST(test_goal_session)
+{
+    libdnf::GoalSession session(test_globals.sack);
+    DnfPackage *pkg = get_latest_pkg(test_globals.sack, "walrus");
+
+    for (int i = 0; i < 2; i++) {
+        libdnf::Goal goal(test_globals.sack);
+        goal.install(pkg, false);
+        fail_if(session.run(goal, DNF_NONE));
+        fail_unless(goal.listInstalls().size() == 2);
+        session.recycle(goal);
+    }
+    g_object_unref(pkg);
+
+    auto & stats = session.getRunStats();
+    fail_unless(stats.size() == 2);
+    fail_unless(stats[1].jobLength == 1);
+    fail_if(stats[1].problems);
+}
+END_TEST
+
 START_TEST(test_goal_install_multilib)
 {
     // Tests installation of multilib package. The package is selected via
@@ -306,6 +354,188 @@ START_TEST(test_goal_install_weak_deps)
 }
 END_TEST
 
+/* the Query based exclude_from_weak_autodetect() of earlier releases, the reference for the
+ * rules the solvable based implementation has to keep */
+static libdnf::PackageSet
+reference_exclude_from_weak(DnfSack *sack)
+{
+    libdnf::PackageSet excludes(sack);
+    libdnf::Query installed_query(sack, libdnf::Query::ExcludeFlags::IGNORE_EXCLUDES);
+    installed_query.installed();
+    if (installed_query.empty())
+        return excludes;
+    libdnf::Query base_query(sack);
+    base_query.apply();
+    auto installed_pset = installed_query.getResultPset();
+    std::vector<const char *> installed_names;
+
+    Id installed_id = -1;
+    while ((installed_id = installed_pset->next(installed_id)) != -1) {
+        g_autoptr(DnfPackage) pkg = dnf_package_new(sack, installed_id);
+        installed_names.push_back(dnf_package_get_name(pkg));
+        std::unique_ptr<libdnf::DependencyContainer> recommends(dnf_package_get_recommends(pkg));
+        for (int i = 0; i < recommends->count(); ++i) {
+            std::unique_ptr<libdnf::Dependency> dep(recommends->getPtr(i));
+            if (dep->toString()[0] == '(')
+                continue;
+            libdnf::Query query(base_query);
+            const char *version = dep->getVersion();
+            if (version && strlen(version) > 0)
+                query.addFilter(HY_PKG_PROVIDES, HY_EQ, dep->getName());
+            else
+                query.addFilter(HY_PKG_PROVIDES, dep.get());
+            if (query.empty())
+                continue;
+            libdnf::Query test_installed(query);
+            test_installed.installed();
+            if (test_installed.empty())
+                excludes += *query.getResultPset();
+        }
+    }
+
+    installed_names.push_back(nullptr);
+    base_query.addFilter(HY_PKG_NAME, HY_NEQ, installed_names.data());
+    auto available_pset = base_query.getResultPset();
+    *available_pset -= *installed_pset;
+    Id available_id = -1;
+    while ((available_id = available_pset->next(available_id)) != -1) {
+        g_autoptr(DnfPackage) pkg = dnf_package_new(sack, available_id);
+        std::unique_ptr<libdnf::DependencyContainer> supplements(dnf_package_get_supplements(pkg));
+        libdnf::DependencyContainer supplements_without_rich(sack);
+        for (int i = 0; i < supplements->count(); ++i) {
+            std::unique_ptr<libdnf::Dependency> dep(supplements->getPtr(i));
+            if (dep->toString()[0] != '(')
+                supplements_without_rich.add(dep.get());
+        }
+        if (supplements_without_rich.count() == 0)
+            continue;
+        libdnf::Query query(installed_query);
+        query.addFilter(HY_PKG_PROVIDES, &supplements_without_rich);
+        if (!query.empty())
+            excludes.set(available_id);
+    }
+    return excludes;
+}
+
+static bool
+packagesets_equal(const libdnf::PackageSet & a, const libdnf::PackageSet & b)
+{
+    if (a.size() != b.size())
+        return false;
+    Id id = -1;
+    while ((id = a.next(id)) != -1) {
+        if (!b.has(id))
+            return false;
+    }
+    return true;
+}
+
+static bool
+excluded_from_weak(const libdnf::PackageSet & excludes, const char *name)
+{
+    g_autoptr(DnfPackage) pkg = by_name_repo(test_globals.sack, name, "weak");
+    return excludes.has(pkg);
+}
+
+START_TEST(test_goal_exclude_from_weak_autodetect)
+{
+    DnfSack *sack = test_globals.sack;
+    libdnf::Goal goal(sack);
+    goal.exclude_from_weak_autodetect();
+    auto & excludes = goal.get_exclude_from_weak();
+
+    // Recommends of installed packages without an installed provider, matched by name only
+    fail_unless(excluded_from_weak(excludes, "rec-missing"));
+    fail_unless(excluded_from_weak(excludes, "rec-versioned"));
+    fail_if(excluded_from_weak(excludes, "rec-present"));
+    fail_if(excluded_from_weak(excludes, "rec-rich"));
+    // Supplements of available packages whose name is not installed
+    fail_unless(excluded_from_weak(excludes, "plugin"));
+    fail_if(excluded_from_weak(excludes, "plugin-other"));
+    fail_if(excluded_from_weak(excludes, "host"));
+    fail_unless(excludes.size() == 3);
+
+    fail_unless(packagesets_equal(excludes, reference_exclude_from_weak(sack)));
+}
+END_TEST
+
+START_TEST(test_goal_exclude_from_weak_autodetect_main)
+{
+    // baby supplements flying, but a baby is installed already
+    DnfSack *sack = test_globals.sack;
+    libdnf::Goal goal(sack);
+    goal.exclude_from_weak_autodetect();
+    fail_unless(goal.get_exclude_from_weak().size() == 0);
+    fail_unless(packagesets_equal(goal.get_exclude_from_weak(), reference_exclude_from_weak(sack)));
+}
+END_TEST
+
+START_TEST(test_goal_exclude_from_weak_autodetect_greedy)
+{
+    // B recommends C and nothing is installed, so C stays a candidate
+    DnfSack *sack = test_globals.sack;
+    libdnf::Goal goal(sack);
+    goal.exclude_from_weak_autodetect();
+    fail_unless(goal.get_exclude_from_weak().size() == 0);
+
+    HySelector sltr = hy_selector_create(sack);
+    hy_selector_set(sltr, HY_PKG_NAME, HY_EQ, "B");
+    fail_if(!hy_goal_install_selector(&goal, sltr, NULL));
+    fail_if(hy_goal_run_flags(&goal, DNF_NONE));
+    assert_iueo(&goal, 2, 0, 0, 0);
+    hy_selector_free(sltr);
+}
+END_TEST
+
+static void
+write_weak_generated_repos(const char *installed_path, const char *available_path,
+                           int npkgs, int ndeps)
+{
+    FILE *installed = fopen(installed_path, "w");
+    FILE *available = fopen(available_path, "w");
+    fail_if(installed == NULL || available == NULL);
+    fprintf(installed, "=Ver: 2.0\n=Pkg: common 1 0 noarch\n");
+    fprintf(available, "=Ver: 2.0\n=Pkg: common 2 0 noarch\n");
+    for (int i = 0; i < npkgs; ++i) {
+        // installed packages share their Recommends, half of them are not installed
+        fprintf(installed, "=Pkg: inst-%d 1 0 noarch\n=Rec: common\n=Rec: dep-%d\n=Rec: dep-%d >= 2\n",
+                i, i % ndeps, (i + 1) % ndeps);
+        fprintf(available, "=Pkg: inst-%d 2 0 noarch\n=Rec: dep-%d\n", i, i % ndeps);
+        fprintf(available, "=Pkg: addon-%d 1 0 noarch\n=Sup: %s-%d\n", i, i % 2 ? "inst" : "none", i);
+    }
+    for (int i = 0; i < ndeps; ++i) {
+        if (i % 2)
+            fprintf(installed, "=Pkg: dep-%d 1 0 noarch\n", i);
+        fprintf(available, "=Pkg: dep-%d 2 0 noarch\n", i);
+    }
+    fclose(installed);
+    fclose(available);
+}
+
+START_TEST(test_goal_exclude_from_weak_autodetect_generated)
+{
+    const int npkgs = 8;
+    const int ndeps = 4;
+    g_autoptr(DnfSack) sack = dnf_sack_new();
+    dnf_sack_set_cachedir(sack, test_globals.tmpdir);
+    dnf_sack_set_arch(sack, TEST_FIXED_ARCH, NULL);
+    fail_unless(dnf_sack_setup(sack, DNF_SACK_SETUP_FLAG_MAKE_CACHE_DIR, NULL));
+    Pool *pool = dnf_sack_get_pool(sack);
+    g_autofree gchar *installed_path = g_build_filename(test_globals.tmpdir, "weak-installed.repo", NULL);
+    g_autofree gchar *available_path = g_build_filename(test_globals.tmpdir, "weak-available.repo", NULL);
+    write_weak_generated_repos(installed_path, available_path, npkgs, ndeps);
+    fail_if(load_repo(pool, HY_SYSTEM_REPO_NAME, installed_path, 1));
+    fail_if(load_repo(pool, "weak", available_path, 0));
+
+    libdnf::Goal goal(sack);
+    goal.exclude_from_weak_autodetect();
+
+    // the even dep-N and the addons of installed packages
+    fail_unless(goal.get_exclude_from_weak().size() == ndeps / 2 + npkgs / 2);
+    fail_unless(packagesets_equal(goal.get_exclude_from_weak(), reference_exclude_from_weak(sack)));
+}
+END_TEST
+
 START_TEST(test_goal_selector_glob)
 {
     HySelector sltr = hy_selector_create(test_globals.sack);
@@ -1395,6 +1625,8 @@ goal_suite(void)
     tcase_add_test(tc, test_goal_sanity);
     tcase_add_test(tc, test_goal_list_err);
     tcase_add_test(tc, test_goal_install);
+    tcase_add_test(tc, test_goal_reset);
+    tcase_add_test(tc, test_goal_session);
     tcase_add_test(tc, test_goal_install_multilib);
     tcase_add_test(tc, test_goal_install_selector);
     tcase_add_test(tc, test_goal_install_selector_err);
@@ -1442,11 +1674,19 @@ goal_suite(void)
     tcase_add_test(tc, test_goal_rerun);
     tcase_add_test(tc, test_goal_unneeded);
     tcase_add_test(tc, test_goal_distupgrade_all_excludes);
+    tcase_add_test(tc, test_goal_exclude_from_weak_autodetect_main);
     suite_add_tcase(s, tc);
 
     tc = tcase_create("Greedy");
     tcase_add_unchecked_fixture(tc, fixture_greedy_only, teardown);
     tcase_add_test(tc, test_goal_install_weak_deps);
+    tcase_add_test(tc, test_goal_exclude_from_weak_autodetect_greedy);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("Weak");
+    tcase_add_unchecked_fixture(tc, fixture_with_weak, teardown);
+    tcase_add_test(tc, test_goal_exclude_from_weak_autodetect);
+    tcase_add_test(tc, test_goal_exclude_from_weak_autodetect_generated);
     suite_add_tcase(s, tc);
 
     tc = tcase_create("Installonly");
@@ -23,6 +23,7 @@
 #include "libdnf/dnf-advisory.h"
 #include "libdnf/hy-package.h"
 #include "libdnf/hy-package-private.hpp"
+#include "libdnf/hy-packageset.h"
 #include "libdnf/hy-query.h"
 #include "libdnf/dnf-reldep.h"
 #include "libdnf/dnf-reldep-list.h"
@@ -226,6 +227,33 @@ START_TEST(test_get_advisories_none)
 }
 END_TEST
 
+START_TEST(test_packageset_get_advisories)
+{
+    DnfSack *sack = test_globals.sack;
+    g_autoptr(DnfPackage) tour = by_name(sack, "tour");
+    g_autoptr(DnfPackage) mystery = by_name(sack, "mystery-devel");
+    g_autoptr(DnfPackageSet) pset = dnf_packageset_new(sack);
+    dnf_packageset_add(pset, tour);
+    dnf_packageset_add(pset, mystery);
+
+    g_autoptr(GPtrArray) perPackage = dnf_packageset_get_advisories(pset, HY_GT|HY_EQ);
+    ck_assert_int_eq(perPackage->len, 2);
+    Id id = -1;
+    for (guint i = 0; i < perPackage->len; ++i) {
+        id = pset->next(id);
+        g_autoptr(DnfPackage) pkg = dnf_package_new(sack, id);
+        g_autoptr(GPtrArray) single = dnf_package_get_advisories(pkg, HY_GT|HY_EQ);
+        auto batch = static_cast<GPtrArray *>(g_ptr_array_index(perPackage, i));
+        ck_assert_int_eq(batch->len, single->len);
+        for (guint j = 0; j < batch->len; ++j) {
+            auto fromBatch = static_cast<DnfAdvisory *>(g_ptr_array_index(batch, j));
+            auto fromSingle = static_cast<DnfAdvisory *>(g_ptr_array_index(single, j));
+            ck_assert_str_eq(dnf_advisory_get_id(fromBatch), dnf_advisory_get_id(fromSingle));
+        }
+    }
+}
+END_TEST
+
 START_TEST(test_lookup_num)
 {
     DnfPackage *pkg = by_name(test_globals.sack, "tour");
@@ -380,6 +408,7 @@ package_suite(void)
     tcase_add_test(tc, test_get_files);
     tcase_add_test(tc, test_get_advisories);
     tcase_add_test(tc, test_get_advisories_none);
+    tcase_add_test(tc, test_packageset_get_advisories);
     tcase_add_test(tc, test_lookup_num);
     tcase_add_test(tc, test_packager);
     tcase_add_test(tc, test_sourcerpm);
@@ -170,6 +170,88 @@ START_TEST(test_get_pkgid)
 }
 END_TEST
 
+START_TEST(test_index_after_change)
+{
+    int max = dnf_sack_last_solvable(test_globals.sack);
+
+    fail_unless((*pset)[2] == max);
+    fail_unless((*pset)[3] == -1);
+    fail_unless(pset->next(max) == -1);
+
+    pset->remove(9);
+    fail_unless((*pset)[1] == max);
+    fail_unless((*pset)[2] == -1);
+    fail_unless(pset->next(0) == max);
+
+    pset->clear();
+    fail_unless(pset->empty());
+    fail_unless((*pset)[0] == -1);
+    fail_unless(pset->next(-1) == -1);
+}
+END_TEST
+
+START_TEST(test_sparse_dense_operations)
+{
+    DnfSack *sack = test_globals.sack;
+    int max = dnf_sack_last_solvable(sack);
+    libdnf::PackageSet sparse(sack);
+    sparse.set(9);
+    fail_unless(sparse.isSparse());
+    fail_if(pset->isSparse());
+
+    libdnf::PackageSet intersection(*pset);
+    intersection /= sparse;
+    fail_unless(intersection.isSparse());
+    fail_unless(intersection.size() == 1);
+    fail_unless(intersection[0] == 9);
+
+    libdnf::PackageSet difference(*pset);
+    difference -= sparse;
+    fail_unless(difference.size() == 2);
+    fail_if(difference.has(9));
+
+    sparse += *pset;
+    fail_unless(sparse.size() == 3);
+    fail_unless(sparse[2] == max);
+
+    pset->remove(0);
+    pset->remove(max);
+    pset->compact();
+    fail_unless(pset->isSparse());
+    fail_unless(pset->next(-1) == 9);
+    fail_unless(pset->next(9) == -1);
+    fail_unless(MAPTST(pset->getMap(), 9));
+    fail_if(pset->isSparse());
+}
+END_TEST
+
+START_TEST(test_shared_map_stays_valid)
+{
+    DnfSack *sack = test_globals.sack;
+    libdnf::PackageSet sparse(sack);
+    sparse.set(9);
+
+    // reading the map of a const set leaves the set as it is
+    const libdnf::PackageSet & constSparse = sparse;
+    fail_unless(MAPTST(constSparse.getMap(), 9));
+    fail_unless(sparse.isSparse());
+    sparse.set(0);
+    fail_unless(MAPTST(constSparse.getMap(), 0));
+
+    // a handed out map keeps working after compacting and intersecting
+    Map *map = pset->getMap();
+    pset->remove(0);
+    pset->remove(dnf_sack_last_solvable(sack));
+    pset->compact();
+    fail_if(pset->isSparse());
+    *pset /= sparse;
+    fail_if(pset->isSparse());
+    fail_unless(map->size > 0);
+    fail_unless(MAPTST(map, 9));
+    fail_unless(map_count(map) == 1);
+}
+END_TEST
+
 Suite *
 packageset_suite(void)
 {
@@ -181,6 +263,9 @@ packageset_suite(void)
     tcase_add_test(tc, test_has);
     tcase_add_test(tc, test_get_clone);
     tcase_add_test(tc, test_get_pkgid);
+    tcase_add_test(tc, test_index_after_change);
+    tcase_add_test(tc, test_sparse_dense_operations);
+    tcase_add_test(tc, test_shared_map_stays_valid);
     suite_add_tcase(s, tc);
 
     return s;
@@ -25,6 +25,8 @@
 #include "libdnf/dnf-reldep.h"
 #include "libdnf/dnf-reldep-list.h"
 #include "libdnf/dnf-sack-private.hpp"
+#include "libdnf/hy-iutil-private.hpp"
+#include "libdnf/hy-repo.h"
 #include "libdnf/repo/solvable/DependencyContainer.hpp"
 #include "libdnf/sack/packageset.hpp"
 #include "libdnf/sack/query.hpp"
@@ -563,6 +565,36 @@ START_TEST(test_filter_latest_archs)
 }
 END_TEST
 
+static void
+check_latest_fool_by_priority(DnfSack *sack, const libdnf::Query & base, const char *evr)
+{
+    libdnf::Query byPriority(base);
+    byPriority.addFilter(HY_PKG_LATEST_PER_ARCH_BY_PRIORITY, HY_EQ, 1);
+    byPriority.addFilter(HY_PKG_NAME, HY_EQ, "fool");
+    fail_unless(byPriority.size() == 1);
+    g_autoptr(DnfPackage) pkg = dnf_package_new(sack, byPriority.getIndexItem(0));
+    ck_assert_str_eq(dnf_package_get_evr(pkg), evr);
+}
+
+START_TEST(test_filter_latest_follows_priority)
+{
+    DnfSack *sack = test_globals.sack;
+    // a single name is sorted on its own, all available packages use the presorted ordering
+    libdnf::Query fool(sack);
+    fool.addFilter(HY_PKG_NAME, HY_EQ, "fool");
+    fool.addFilter(HY_PKG_REPONAME, HY_NEQ, HY_SYSTEM_REPO_NAME);
+    libdnf::Query available(sack);
+    available.addFilter(HY_PKG_REPONAME, HY_NEQ, HY_SYSTEM_REPO_NAME);
+    check_latest_fool_by_priority(sack, fool, "1-5");
+    check_latest_fool_by_priority(sack, available, "1-5");
+
+    // the presorted order must not survive a priority change, the tcase has a sack of its own
+    hy_repo_set_priority(hrepo_by_name(sack, "main"), 1);
+    check_latest_fool_by_priority(sack, fool, "1-3");
+    check_latest_fool_by_priority(sack, available, "1-3");
+}
+END_TEST
+
 START_TEST(test_upgrade_already_installed)
 {
     /* if pkg is installed in two versions and the later is available in repos,
@@ -721,6 +753,32 @@ START_TEST(test_query_reldep_arbitrary)
 }
 END_TEST
 
+START_TEST(test_query_explain)
+{
+    DnfSack *sack = test_globals.sack;
+
+    libdnf::Query query(sack);
+    query.addFilter(HY_PKG_NAME, HY_GLOB, "p*");
+    query.addFilter(HY_PKG_REPONAME, HY_EQ, "no-such-repo");
+    std::string plan = query.explain();
+    fail_unless(query.empty());
+    fail_if(plan.find("1. reponame") == std::string::npos, plan.c_str());
+    fail_if(plan.find("2. name glob") == std::string::npos, plan.c_str());
+    fail_if(plan.find("skipped") == std::string::npos, plan.c_str());
+
+    // latest depends on the packages before it and must not be moved past the name filter
+    libdnf::Query latest(sack);
+    latest.addFilter(HY_PKG_LATEST, HY_EQ, 1);
+    latest.addFilter(HY_PKG_NAME, HY_EQ, "jay");
+    plan = latest.explain();
+    fail_if(plan.find("1. latest") == std::string::npos, plan.c_str());
+    libdnf::Query reference(sack);
+    reference.addFilter(HY_PKG_NAME, HY_EQ, "jay");
+    reference.addFilter(HY_PKG_LATEST, HY_EQ, 1);
+    ck_assert_int_eq(latest.size(), reference.size());
+}
+END_TEST
+
 START_TEST(test_filter_files)
 {
     HyQuery q = hy_query_create(test_globals.sack);
@@ -741,6 +799,95 @@ START_TEST(test_filter_files)
 }
 END_TEST
 
+START_TEST(test_filter_files_repeated)
+{
+    // the first lookups scan the filelists, the later ones are answered by the file index
+    for (int i = 0; i < 12; ++i) {
+        HyQuery q = hy_query_create(test_globals.sack);
+        hy_query_filter(q, HY_PKG_FILE, HY_EQ, "/etc/takeyouaway");
+        fail_unless(size_and_free(q) == 1);
+
+        q = hy_query_create(test_globals.sack);
+        hy_query_filter(q, HY_PKG_FILE, HY_EQ, "/etc");
+        fail_unless(size_and_free(q) == 0);
+
+        q = hy_query_create(test_globals.sack);
+        hy_query_filter(q, HY_PKG_FILE, HY_EQ, "/etc/takeyouaway/");
+        fail_unless(size_and_free(q) == 0);
+
+        q = hy_query_create(test_globals.sack);
+        hy_query_filter(q, HY_PKG_FILE, HY_GLOB, "/usr/*");
+        fail_unless(size_and_free(q) == 2);
+
+        q = hy_query_create(test_globals.sack);
+        hy_query_filter(q, HY_PKG_NAME, HY_EQ, "tour");
+        hy_query_filter(q, HY_PKG_FILE, HY_GLOB, "/etc/take*");
+        fail_unless(size_and_free(q) == 1);
+    }
+}
+END_TEST
+
+START_TEST(test_filter_files_negated)
+{
+    HyQuery q = hy_query_create(test_globals.sack);
+    int all = size_and_free(q);
+
+    q = hy_query_create(test_globals.sack);
+    hy_query_filter(q, HY_PKG_FILE, HY_GLOB|HY_NOT, "/usr/*");
+    fail_unless(size_and_free(q) == all - 2);
+
+    q = hy_query_create(test_globals.sack);
+    hy_query_filter(q, HY_PKG_FILE, HY_NEQ, "/etc/takeyouaway");
+    fail_unless(size_and_free(q) == all - 1);
+
+    // no literal prefix, not answered by the file index
+    q = hy_query_create(test_globals.sack);
+    hy_query_filter(q, HY_PKG_FILE, HY_GLOB, "*/takeyouaway");
+    fail_unless(size_and_free(q) == 1);
+}
+END_TEST
+
+static void
+check_filter_subjects(const std::vector<std::string> & subjects, bool with_provides,
+    bool with_filenames)
+{
+    DnfSack *sack = test_globals.sack;
+
+    libdnf::Query query(sack);
+    auto matched = query.filterSubjects(subjects, false, true, with_provides, with_filenames);
+    ck_assert_int_eq(matched.size(), subjects.size());
+    for (std::size_t i = 0; i < subjects.size(); ++i) {
+        libdnf::Query single(sack);
+        auto ret = single.filterSubject(subjects[i].c_str(), nullptr, false, true, with_provides,
+                                        with_filenames);
+        fail_unless(ret.first == !matched[i].empty(), subjects[i].c_str());
+        ck_assert_int_eq(single.size(), matched[i].size());
+    }
+    fail_unless(matched.back().empty());
+}
+
+START_TEST(test_query_filter_subjects)
+{
+    check_filter_subjects({"penny", "penny-lib*", "jay-5.0-0.x86_64", "jay-[45]*",
+        "semolina.i686", "*.noarch", "baby-6:4.9-3", "*-devel-4", "no-such-package"},
+        false, false);
+}
+END_TEST
+
+START_TEST(test_query_filter_subjects_provides)
+{
+    check_filter_subjects({"P", "P-l*", "P-lib = 3-3", "walrus <= 2-5", "fool > 2", "penny",
+        "P*", "no-such-provide*"}, true, false);
+}
+END_TEST
+
+START_TEST(test_query_filter_subjects_files)
+{
+    check_filter_subjects({"/etc/takeyouaway", "/usr/*", "*/takeyouaway", "tour",
+        "/no-such-dir/*"}, true, true);
+}
+END_TEST
+
 START_TEST(test_filter_sourcerpm)
 {
     HyQuery q = hy_query_create(test_globals.sack);
@@ -974,6 +1121,20 @@ START_TEST(test_filter_advisory_cve)
 }
 END_TEST
 
+START_TEST(test_filter_advisory_cves)
+{
+    const char *cves[] = {"CVE-0000-UNKNOWN", "CVE-1967-BEATLES", NULL};
+    libdnf::Query query(test_globals.sack);
+    query.addFilter(HY_PKG_ADVISORY_CVE, HY_EQ, cves);
+    fail_unless(query.size() == 2);
+
+    const char *unknown[] = {"CVE-0000-UNKNOWN", NULL};
+    libdnf::Query none(test_globals.sack);
+    none.addFilter(HY_PKG_ADVISORY_CVE, HY_EQ, unknown);
+    fail_unless(none.empty());
+}
+END_TEST
+
 START_TEST(test_filter_advisory_bug)
 {
     HyQuery q = hy_query_create(test_globals.sack);
@@ -1091,6 +1252,7 @@ query_suite(void)
     tcase_add_test(tc, test_query_reldep);
     tcase_add_test(tc, test_query_reldep_arbitrary);
     tcase_add_test(tc, test_query_conflicts);
+    tcase_add_test(tc, test_query_explain);
     suite_add_tcase(s, tc);
 
     tc = tcase_create("Full");
@@ -1099,14 +1261,24 @@ query_suite(void)
     tcase_add_test(tc, test_filter_latest_archs);
     tcase_add_test(tc, test_filter_obsoletes);
     tcase_add_test(tc, test_filter_reponames);
+    tcase_add_test(tc, test_query_filter_subjects);
+    tcase_add_test(tc, test_query_filter_subjects_provides);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("Priority");
+    tcase_add_unchecked_fixture(tc, fixture_all, teardown);
+    tcase_add_test(tc, test_filter_latest_follows_priority);
     suite_add_tcase(s, tc);
 
     tc = tcase_create("Filelists etc.");
     tcase_add_unchecked_fixture(tc, fixture_yum, teardown);
     tcase_add_test(tc, test_filter_files);
+    tcase_add_test(tc, test_filter_files_repeated);
+    tcase_add_test(tc, test_filter_files_negated);
     tcase_add_test(tc, test_filter_sourcerpm);
     tcase_add_test(tc, test_filter_description);
     tcase_add_test(tc, test_query_location);
+    tcase_add_test(tc, test_query_filter_subjects_files);
     suite_add_tcase(s, tc);
 
     tc = tcase_create("Excluding");
@@ -1121,6 +1293,7 @@ query_suite(void)
     tcase_add_test(tc, test_filter_advisory);
     tcase_add_test(tc, test_filter_advisory_type);
     tcase_add_test(tc, test_filter_advisory_cve);
+    tcase_add_test(tc, test_filter_advisory_cves);
     tcase_add_test(tc, test_filter_advisory_bug);
     suite_add_tcase(s, tc);
 
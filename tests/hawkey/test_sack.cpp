@@ -25,6 +25,8 @@
 #include "libdnf/dnf-sack-private.hpp"
 #include "libdnf/hy-util.h"
 #include "libdnf/hy-iutil-private.hpp"
+#include "libdnf/dnf-context.hpp"
+#include "libdnf/dnf-state.h"
 
 #include "fixtures.h"
 #include "testsys.h"
@@ -172,6 +174,29 @@ START_TEST(test_add_cmdline_package)
 }
 END_TEST
 
+START_TEST(test_name_index_follows_cmdline_packages)
+{
+    g_autoptr(DnfSack) sack = dnf_sack_new();
+    dnf_sack_set_cachedir(sack, test_globals.tmpdir);
+
+    g_autofree gchar *path_mystery = g_build_filename (TESTDATADIR, "/hawkey/yum/mystery-devel-19.67-1.noarch.rpm", NULL);
+    g_autoptr(DnfPackage) pkg_mystery = dnf_sack_add_cmdline_package (sack, path_mystery);
+    libdnf::Query query(sack);
+    query.addFilter(HY_PKG_NAME, HY_EQ, "tour");
+    fail_unless(query.size() == 0);
+
+    g_autofree gchar *path_tour = g_build_filename (TESTDATADIR, "/hawkey/yum/tour-4-6.noarch.rpm", NULL);
+    g_autoptr(DnfPackage) pkg_tour = dnf_sack_add_cmdline_package (sack, path_tour);
+    libdnf::Query byName(sack);
+    byName.addFilter(HY_PKG_NAME, HY_EQ, "tour");
+    fail_unless(byName.size() == 1);
+
+    libdnf::Query bySourcerpm(sack);
+    bySourcerpm.addFilter(HY_PKG_SOURCERPM, HY_EQ, dnf_package_get_sourcerpm(pkg_tour));
+    fail_unless(bySourcerpm.size() == 1);
+}
+END_TEST
+
 START_TEST(test_repo_load)
 {
     fail_unless(dnf_sack_count(test_globals.sack) ==
@@ -179,6 +204,71 @@ START_TEST(test_repo_load)
 }
 END_TEST
 
+static gboolean
+refill_system_repo(DnfSack *sack, const char *name)
+{
+    Pool *pool = dnf_sack_get_pool(sack);
+    const char *path = pool_tmpjoin(pool, test_globals.repo_dir, name, ".repo");
+    return dnf_sack_refill_system_repo(sack, [path](Repo *repo, Repo *) {
+        FILE *fp = fopen(path, "r");
+        if (!fp)
+            return false;
+        testcase_add_testtags(repo, fp, 0);
+        fclose(fp);
+        return true;
+    }, NULL);
+}
+
+static int
+count_installed(DnfSack *sack)
+{
+    libdnf::Query query(sack);
+    query.installed();
+    return query.size();
+}
+
+START_TEST(test_refill_system_repo)
+{
+    DnfSack *sack = test_globals.sack;
+    Pool *pool = dnf_sack_get_pool(sack);
+    auto & mainConf = libdnf::getGlobalMainConfig(false);
+    mainConf.includepkgs().set(libdnf::Option::Priority::RUNTIME,
+                               std::vector<std::string>{"penny*", "k", "k-m"});
+    mainConf.excludepkgs().set(libdnf::Option::Priority::RUNTIME,
+                               std::vector<std::string>{"k-m"});
+
+    /* no repos to load, only the main includes/excludes get applied */
+    g_autoptr(GPtrArray) repos = g_ptr_array_new();
+    g_autoptr(DnfState) state = dnf_state_new();
+    fail_unless(dnf_sack_add_repos(sack, repos, 0, DNF_SACK_ADD_FLAG_NONE, state, NULL));
+    fail_unless(count_installed(sack) == 2);
+
+    /* newly installed packages are filtered by the main config too */
+    fail_unless(refill_system_repo(sack, "@System-k"));
+    fail_unless(count_installed(sack) == 4);
+    int nsolvables = pool->nsolvables;
+
+    fail_unless(refill_system_repo(sack, HY_SYSTEM_REPO_NAME));
+    fail_unless(count_installed(sack) == 2);
+
+    /* the installed repo is last in the pool now, its ids are reused */
+    fail_unless(refill_system_repo(sack, "@System-k"));
+    fail_unless(count_installed(sack) == 4);
+    fail_unless(pool->nsolvables == nsolvables);
+    fail_unless(refill_system_repo(sack, "@System-k"));
+    fail_unless(pool->nsolvables == nsolvables);
+}
+END_TEST
+
+static void
+teardown_main_config(void)
+{
+    auto & mainConf = libdnf::getGlobalMainConfig(false);
+    mainConf.includepkgs().set(libdnf::Option::Priority::RUNTIME, std::vector<std::string>{});
+    mainConf.excludepkgs().set(libdnf::Option::Priority::RUNTIME, std::vector<std::string>{});
+    teardown();
+}
+
 static void
 check_filelist(Pool *pool)
 {
@@ -297,6 +387,7 @@ sack_suite(void)
     tcase_add_test(tc, test_load_repo_err);
     tcase_add_test(tc, test_repo_written);
     tcase_add_test(tc, test_add_cmdline_package);
+    tcase_add_test(tc, test_name_index_follows_cmdline_packages);
     suite_add_tcase(s, tc);
 
     tc = tcase_create("Repos");
@@ -304,6 +395,11 @@ sack_suite(void)
     tcase_add_test(tc, test_repo_load);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("SystemReload");
+    tcase_add_unchecked_fixture(tc, fixture_with_main, teardown_main_config);
+    tcase_add_test(tc, test_refill_system_repo);
+    suite_add_tcase(s, tc);
+
     tc = tcase_create("YumRepo");
     tcase_add_unchecked_fixture(tc, fixture_yum, teardown);
     tcase_add_test(tc, test_filelist);
@@ -1246,6 +1246,114 @@ dnf_context_cache_clean_check_func(void)
     g_assert_no_error(error);
 }
 
+static void
+dnf_repo_download_packages_from_repos_func(void)
+{
+    gboolean ret;
+    guint i;
+    HyQuery query;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(DnfContext) ctx = NULL;
+    g_autoptr(DnfSack) sack = NULL;
+    g_autoptr(DnfState) state = NULL;
+    g_autoptr(GPtrArray) packages = NULL;
+    g_autofree gchar *repos_dir = NULL;
+    g_autofree gchar *cache_dir = NULL;
+    g_autofree gchar *download_dir = NULL;
+    g_autofree gchar *max_parallel = NULL;
+    g_autoptr(GPtrArray) one_package = NULL;
+    enum DnfConfPriority priority;
+    DnfPackage *pkg_one = NULL;
+    GPtrArray *repos;
+
+    cache_dir = g_dir_make_tmp("libdnf-test-download-XXXXXX", &error);
+    g_assert_no_error(error);
+    download_dir = g_build_filename(cache_dir, "downloads", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(download_dir, 0755), ==, 0);
+
+    /* set up local context with two repos */
+    ctx = dnf_context_new();
+    repos_dir = dnf_test_get_filename("download/yum.repos.d");
+    dnf_context_set_repo_dir(ctx, repos_dir);
+    dnf_context_set_solv_dir(ctx, cache_dir);
+    dnf_context_set_cache_dir(ctx, cache_dir);
+    dnf_context_set_lock_dir(ctx, cache_dir);
+    ret = dnf_context_setup(ctx, NULL, &error);
+    g_assert_no_error(error);
+    g_assert(ret);
+    repos = dnf_context_get_repos(ctx);
+    g_assert_cmpint(repos->len, ==, 2);
+
+    sack = dnf_sack_new();
+    dnf_sack_set_cachedir(sack, cache_dir);
+    ret = dnf_sack_set_arch(sack, "x86_64", &error);
+    g_assert_no_error(error);
+    g_assert(ret);
+    state = dnf_state_new();
+    ret = dnf_sack_add_repos(sack, repos, G_MAXUINT, DNF_SACK_ADD_FLAG_NONE, state, &error);
+    g_assert_no_error(error);
+    g_assert(ret);
+
+    /* libnghttp2 is in both repos */
+    query = hy_query_create(sack);
+    hy_query_filter(query, HY_PKG_NAME, HY_EQ, "libnghttp2");
+    packages = hy_query_run(query);
+    hy_query_free(query);
+    g_assert_cmpint(packages->len, ==, 2);
+    g_assert(dnf_package_get_repo(g_ptr_array_index(packages, 0)) !=
+             dnf_package_get_repo(g_ptr_array_index(packages, 1)));
+
+    /* one transfer for both repos, limited by the main configuration */
+    max_parallel = dnf_conf_main_get_option("max_parallel_downloads", &priority, &error);
+    g_assert_no_error(error);
+    ret = dnf_conf_main_set_option("max_parallel_downloads", DNF_CONF_RUNTIME, "2", &error);
+    g_assert_no_error(error);
+    g_assert(ret);
+    g_test_expect_message("libdnf", G_LOG_LEVEL_DEBUG,
+                          "Downloading 2 packages from 2 repos, 2 at once*");
+    dnf_state_reset(state);
+    ret = dnf_repo_download_packages_from_repos(packages, download_dir, state, &error);
+    g_assert_no_error(error);
+    g_assert(ret);
+    g_test_assert_expected_messages();
+    for (i = 0; i < packages->len; i++) {
+        DnfPackage *pkg = g_ptr_array_index(packages, i);
+        g_autofree gchar *basename = g_path_get_basename(dnf_package_get_location(pkg));
+        g_autofree gchar *filename = g_build_filename(download_dir, basename, NULL);
+        g_assert(g_file_test(filename, G_FILE_TEST_EXISTS));
+    }
+
+    /* the packages are there already */
+    dnf_state_reset(state);
+    ret = dnf_repo_download_packages_from_repos(packages, download_dir, state, &error);
+    g_assert_no_error(error);
+    g_assert(ret);
+    ret = dnf_conf_main_set_option("max_parallel_downloads", DNF_CONF_RUNTIME, max_parallel, &error);
+    g_assert_no_error(error);
+    g_assert(ret);
+
+    /* a single repo transfer keeps the limit of download-one */
+    for (i = 0; i < packages->len; i++) {
+        DnfPackage *pkg = g_ptr_array_index(packages, i);
+        if (g_strcmp0(dnf_package_get_reponame(pkg), "download-one") == 0)
+            pkg_one = pkg;
+    }
+    g_assert(pkg_one != NULL);
+    one_package = g_ptr_array_new();
+    g_ptr_array_add(one_package, pkg_one);
+    g_test_expect_message("libdnf", G_LOG_LEVEL_DEBUG,
+                          "Downloading 1 packages from download-one, 1 at once*");
+    dnf_state_reset(state);
+    ret = dnf_repo_download_packages(dnf_package_get_repo(pkg_one), one_package,
+                                     download_dir, state, &error);
+    g_assert_no_error(error);
+    g_assert(ret);
+    g_test_assert_expected_messages();
+
+    dnf_remove_recursive(cache_dir, &error);
+    g_assert_no_error(error);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -1279,6 +1387,7 @@ main(int argc, char **argv)
     g_test_add_func("/libdnf/split_releasever", dnf_split_releasever_func);
     g_test_add_func("/libdnf/repo", ch_test_repo_func);
     g_test_add_func("/libdnf/repo_empty_keyfile", dnf_repo_setup_with_empty_keyfile);
+    g_test_add_func("/libdnf/repo{download-from-repos}", dnf_repo_download_packages_from_repos_func);
     g_test_add_func("/libdnf/state", dnf_state_func);
     g_test_add_func("/libdnf/state[child]", dnf_state_child_func);
     g_test_add_func("/libdnf/state[parent-1-step]", dnf_state_parent_one_step_proxy_func);
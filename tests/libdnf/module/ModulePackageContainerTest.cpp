@@ -156,3 +156,30 @@ void ModulePackageContainerTest::testInstallRemoveProfile()
 
     modules->save();
 }
+
+void ModulePackageContainerTest::testQueryNSVCA()
+{
+    auto byName = modules->query("httpd", "", "", "", "");
+    CPPUNIT_ASSERT(!byName.empty());
+    for (auto pkg : byName)
+        CPPUNIT_ASSERT_EQUAL(std::string("httpd"), pkg->getName());
+
+    auto byNameStream = modules->query("httpd", "2.4", "", "", "");
+    CPPUNIT_ASSERT(!byNameStream.empty());
+    CPPUNIT_ASSERT(byNameStream.size() <= byName.size());
+    for (auto pkg : byNameStream)
+        CPPUNIT_ASSERT_EQUAL(std::string("2.4"), pkg->getStream());
+
+    // glob patterns go through every module and must agree with the exact lookups
+    CPPUNIT_ASSERT(modules->query("http?", "", "", "", "") == byName);
+    CPPUNIT_ASSERT(modules->query("http[d]", "2.*", "", "", "") ==
+                   modules->query("httpd", "2.*", "", "", ""));
+    CPPUNIT_ASSERT(modules->query("httpd", "2.[4]", "", "", "") == byNameStream);
+
+    auto pkg = byNameStream.front();
+    auto exact = modules->query(pkg->getName(), pkg->getStream(), pkg->getVersion(),
+                                pkg->getContext(), pkg->getArch());
+    CPPUNIT_ASSERT(std::find(exact.begin(), exact.end(), pkg) != exact.end());
+    CPPUNIT_ASSERT(modules->query("httpd", "2.4", "", "", "no-such-arch").empty());
+    CPPUNIT_ASSERT(modules->query("no-such-module", "", "", "", "").empty());
+}
@@ -0,0 +1,188 @@
+#include "DnfPackageIndexTest.hpp"
+
+#include "libdnf/dnf-package.h"
+#include "libdnf/dnf-transaction-private.hpp"
+#include "libdnf/dnf-utils.h"
+#include "libdnf/hy-iutil-private.hpp"
+#include "libdnf/sack/query.hpp"
+
+#include <rpm/header.h>
+#include <rpm/rpmtag.h>
+
+#include <string>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DnfPackageIndexTest);
+
+#define UNITTEST_DIR "/tmp/libdnfXXXXXX"
+
+/* the lookups of the rpm transaction callback before the index: a scan of the array */
+
+static DnfPackage *
+scanByHeader(GPtrArray *array, Header hdr)
+{
+    const gchar *name = headerGetString(hdr, RPMTAG_NAME);
+    guint epoch = headerGetNumber(hdr, RPMTAG_EPOCH);
+    const gchar *version = headerGetString(hdr, RPMTAG_VERSION);
+    const gchar *release = headerGetString(hdr, RPMTAG_RELEASE);
+    const gchar *arch = headerGetString(hdr, RPMTAG_ARCH);
+
+    for (guint i = 0; i < array->len; i++) {
+        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(array, i));
+        if (g_strcmp0(name, dnf_package_get_name(pkg)) == 0 &&
+            g_strcmp0(version, dnf_package_get_version(pkg)) == 0 &&
+            g_strcmp0(release, dnf_package_get_release(pkg)) == 0 &&
+            g_strcmp0(arch, dnf_package_get_arch(pkg)) == 0 &&
+            epoch == dnf_package_get_epoch(pkg))
+            return pkg;
+    }
+    return nullptr;
+}
+
+static DnfPackage *
+scanByFilenameSuffix(GPtrArray *array, const gchar *filename_suffix)
+{
+    for (guint i = 0; i < array->len; i++) {
+        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(array, i));
+        auto filename = dnf_package_get_filename(pkg);
+        if (filename != nullptr && g_str_has_suffix(filename, filename_suffix))
+            return pkg;
+    }
+    return nullptr;
+}
+
+static DnfPackage *
+scanByName(GPtrArray *array, const gchar *pkgname)
+{
+    for (guint i = 0; i < array->len; i++) {
+        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(array, i));
+        if (g_strcmp0(dnf_package_get_name(pkg), pkgname) == 0)
+            return pkg;
+    }
+    return nullptr;
+}
+
+/* a header as rpm hands it to the transaction callback */
+static Header
+newHeader(const char *name, uint32_t epoch, const char *version, const char *release, const char *arch)
+{
+    Header hdr = headerNew();
+    headerPutString(hdr, RPMTAG_NAME, name);
+    if (epoch)
+        headerPutUint32(hdr, RPMTAG_EPOCH, &epoch, 1);
+    headerPutString(hdr, RPMTAG_VERSION, version);
+    headerPutString(hdr, RPMTAG_RELEASE, release);
+    headerPutString(hdr, RPMTAG_ARCH, arch);
+    return hdr;
+}
+
+static void
+addPackage(GPtrArray *packages, DnfSack *sack, Id id, const std::string & directory)
+{
+    DnfPackage *pkg = dnf_package_new(sack, id);
+    g_autofree gchar *basename = g_path_get_basename(dnf_package_get_location(pkg));
+    g_autofree gchar *filename = g_build_filename(directory.c_str(), basename, NULL);
+    dnf_package_set_filename(pkg, filename);
+    g_ptr_array_add(packages, pkg);
+}
+
+void
+DnfPackageIndexTest::setUp()
+{
+    g_autoptr(GError) error = nullptr;
+
+    tmpdir = g_strdup(UNITTEST_DIR);
+    char *retptr = mkdtemp(tmpdir);
+    CPPUNIT_ASSERT(retptr);
+
+    sack = dnf_sack_new();
+    dnf_sack_set_cachedir(sack, tmpdir);
+    dnf_sack_set_arch(sack, "x86_64", NULL);
+    dnf_sack_setup(sack, 0, NULL);
+    repo = hy_repo_create("test_package_index_repo");
+    std::string repodata = std::string(TESTDATADIR "/advisories/repodata/");
+    hy_repo_set_string(repo, HY_REPO_MD_FN, (repodata + "repomd.xml").c_str());
+    hy_repo_set_string(repo, HY_REPO_PRIMARY_FN, (repodata + "primary.xml.gz").c_str());
+    CPPUNIT_ASSERT(dnf_sack_load_repo(sack, repo, 0, &error));
+
+    // two builds of test-perl-DBI, then the first one again from another directory: the index
+    // has to return the first match of every key, just like the scan
+    libdnf::Query query(sack);
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), query.size());
+    packages = g_ptr_array_new_with_free_func(g_object_unref);
+    for (size_t i = 0; i < query.size(); i++)
+        addPackage(packages, sack, query.getIndexItem(i), std::string(tmpdir) + "/packages");
+    addPackage(packages, sack, query.getIndexItem(0), std::string(tmpdir) + "/other");
+}
+
+void
+DnfPackageIndexTest::tearDown()
+{
+    g_ptr_array_unref(packages);
+    dnf_remove_recursive_v2(tmpdir, NULL);
+    delete repo;
+    g_object_unref(sack);
+    g_free(tmpdir);
+}
+
+void
+DnfPackageIndexTest::testFindMatchesScan()
+{
+    DnfPackageIndex index(packages);
+
+    for (guint i = 0; i < packages->len; i++) {
+        auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(packages, i));
+
+        Header hdr = newHeader(dnf_package_get_name(pkg),
+                               dnf_package_get_epoch(pkg),
+                               dnf_package_get_version(pkg),
+                               dnf_package_get_release(pkg),
+                               dnf_package_get_arch(pkg));
+        auto expected = scanByHeader(packages, hdr);
+        CPPUNIT_ASSERT(expected != nullptr);
+        CPPUNIT_ASSERT_EQUAL(expected, dnf_find_pkg_from_header(&index, hdr));
+        headerFree(hdr);
+
+        auto filename = dnf_package_get_filename(pkg);
+        CPPUNIT_ASSERT_EQUAL(pkg, dnf_find_pkg_from_filename_suffix(&index, filename));
+        CPPUNIT_ASSERT_EQUAL(scanByFilenameSuffix(packages, filename),
+                             dnf_find_pkg_from_filename_suffix(&index, filename));
+
+        // rpm may report only the tail of the filename
+        g_autofree gchar *basename = g_path_get_basename(filename);
+        CPPUNIT_ASSERT_EQUAL(scanByFilenameSuffix(packages, basename),
+                             dnf_find_pkg_from_filename_suffix(&index, basename));
+
+        CPPUNIT_ASSERT_EQUAL(scanByName(packages, dnf_package_get_name(pkg)),
+                             dnf_find_pkg_from_name(&index, dnf_package_get_name(pkg)));
+    }
+}
+
+void
+DnfPackageIndexTest::testFindMissing()
+{
+    DnfPackageIndex index(packages);
+    auto pkg = static_cast< DnfPackage * >(g_ptr_array_index(packages, 0));
+
+    // same name, version, release and arch, but another epoch
+    Header hdr = newHeader(dnf_package_get_name(pkg),
+                           dnf_package_get_epoch(pkg) + 1,
+                           dnf_package_get_version(pkg),
+                           dnf_package_get_release(pkg),
+                           dnf_package_get_arch(pkg));
+    CPPUNIT_ASSERT(scanByHeader(packages, hdr) == nullptr);
+    CPPUNIT_ASSERT(dnf_find_pkg_from_header(&index, hdr) == nullptr);
+    headerFree(hdr);
+
+    hdr = newHeader(dnf_package_get_name(pkg),
+                    dnf_package_get_epoch(pkg),
+                    dnf_package_get_version(pkg),
+                    dnf_package_get_release(pkg),
+                    "i686");
+    CPPUNIT_ASSERT(scanByHeader(packages, hdr) == nullptr);
+    CPPUNIT_ASSERT(dnf_find_pkg_from_header(&index, hdr) == nullptr);
+    headerFree(hdr);
+
+    CPPUNIT_ASSERT(dnf_find_pkg_from_filename_suffix(&index, "missing-1-1.x86_64.rpm") == nullptr);
+    CPPUNIT_ASSERT(dnf_find_pkg_from_name(&index, "missing") == nullptr);
+    CPPUNIT_ASSERT(dnf_find_pkg_from_name(&index, nullptr) == nullptr);
+}
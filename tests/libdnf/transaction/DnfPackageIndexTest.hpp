@@ -0,0 +1,30 @@
+#ifndef LIBDNF_DNFPACKAGEINDEXTEST_HPP
+#define LIBDNF_DNFPACKAGEINDEXTEST_HPP
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "libdnf/dnf-sack.h"
+#include "libdnf/hy-repo.h"
+
+class DnfPackageIndexTest : public CppUnit::TestCase {
+    CPPUNIT_TEST_SUITE(DnfPackageIndexTest);
+    CPPUNIT_TEST(testFindMatchesScan);
+    CPPUNIT_TEST(testFindMissing);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testFindMatchesScan();
+    void testFindMissing();
+
+private:
+    DnfSack *sack = nullptr;
+    HyRepo repo = nullptr;
+    char *tmpdir = nullptr;
+    GPtrArray *packages = nullptr;
+};
+
+#endif // LIBDNF_DNFPACKAGEINDEXTEST_HPP
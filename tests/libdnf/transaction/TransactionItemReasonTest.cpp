@@ -325,6 +325,49 @@ TransactionItemReasonTest::testRemovedPackage()
         static_cast< TransactionItemReason >(swdb.resolveRPMTransactionItemReason("bash", "", -1)));
 }
 
+// reasons of all packages resolved at once match the reasons resolved one by one
+void
+TransactionItemReasonTest::testResolveReasonsInBulk()
+{
+    Swdb swdb(conn);
+
+    auto addRpm = [&](const std::string & name, const std::string & arch,
+                      TransactionItemAction action, TransactionItemReason reason) {
+        swdb.initTransaction();
+
+        auto rpm = std::make_shared< RPMItem >(conn);
+        rpm->setName(name);
+        rpm->setEpoch(0);
+        rpm->setVersion("1.0");
+        rpm->setRelease("1.fc26");
+        rpm->setArch(arch);
+        auto ti = swdb.addItem(rpm, "base", action, reason);
+        ti->setState(TransactionItemState::DONE);
+
+        swdb.beginTransaction(1, "", "", 0);
+        swdb.endTransaction(2, "", TransactionState::DONE);
+        swdb.closeTransaction();
+    };
+
+    addRpm("bash", "x86_64", TransactionItemAction::INSTALL, TransactionItemReason::GROUP);
+    addRpm("bash", "i686", TransactionItemAction::INSTALL, TransactionItemReason::USER);
+    addRpm("bash", "i686", TransactionItemAction::REMOVE, TransactionItemReason::USER);
+    addRpm("glibc", "x86_64", TransactionItemAction::INSTALL, TransactionItemReason::USER);
+    addRpm("glibc", "x86_64", TransactionItemAction::REASON_CHANGE,
+           TransactionItemReason::DEPENDENCY);
+
+    auto reasons = RPMItem::resolveTransactionItemReasons(conn);
+    CPPUNIT_ASSERT_EQUAL(static_cast< size_t >(3), reasons.size());
+    for (const auto & item : reasons) {
+        CPPUNIT_ASSERT_EQUAL(
+            swdb.resolveRPMTransactionItemReason(item.first.first, item.first.second, -1),
+            item.second);
+    }
+    CPPUNIT_ASSERT_EQUAL(TransactionItemReason::GROUP, reasons[{"bash", "x86_64"}]);
+    CPPUNIT_ASSERT_EQUAL(TransactionItemReason::UNKNOWN, reasons[{"bash", "i686"}]);
+    CPPUNIT_ASSERT_EQUAL(TransactionItemReason::DEPENDENCY, reasons[{"glibc", "x86_64"}]);
+}
+
 void
 TransactionItemReasonTest::testCompareReasons()
 {
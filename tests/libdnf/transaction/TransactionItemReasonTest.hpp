@@ -15,6 +15,7 @@ class TransactionItemReasonTest : public CppUnit::TestCase {
     CPPUNIT_TEST(test_OneTransaction_TwoTransactionItems);
     CPPUNIT_TEST(test_TwoTransactions_TwoTransactionItems);
     CPPUNIT_TEST(testRemovedPackage);
+    CPPUNIT_TEST(testResolveReasonsInBulk);
     CPPUNIT_TEST(testCompareReasons);
     CPPUNIT_TEST(testTransactionItemReasonCompare);
     CPPUNIT_TEST_SUITE_END();
@@ -30,6 +31,7 @@ public:
     void test_OneTransaction_TwoTransactionItems();
     void test_TwoTransactions_TwoTransactionItems();
     void testRemovedPackage();
+    void testResolveReasonsInBulk();
     void testCompareReasons();
     void testTransactionItemReasonCompare();
 
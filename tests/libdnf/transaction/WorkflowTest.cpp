@@ -7,6 +7,7 @@
 #include "libdnf/transaction/CompsEnvironmentItem.hpp"
 #include "libdnf/transaction/CompsGroupItem.hpp"
 #include "libdnf/transaction/RPMItem.hpp"
+#include "libdnf/transaction/Swdb.hpp"
 #include "libdnf/transaction/Transaction.hpp"
 #include "libdnf/transaction/TransactionItem.hpp"
 #include "libdnf/transaction/Transformer.hpp"
@@ -159,3 +160,42 @@ WorkflowTest::testDefaultWorkflow()
         }
     }
 }
+
+void
+WorkflowTest::testBatchedWrites()
+{
+    Swdb swdb(conn);
+    swdb.initTransaction();
+
+    auto rpm_bash = swdb.createRPMItem();
+    rpm_bash->setName("bash");
+    rpm_bash->setEpoch(0);
+    rpm_bash->setVersion("4.4.12");
+    rpm_bash->setRelease("5.fc26");
+    rpm_bash->setArch("x86_64");
+    swdb.addItem(rpm_bash, "base", TransactionItemAction::INSTALL, TransactionItemReason::USER);
+
+    auto id = swdb.beginTransaction(1, "abc", "install bash", 0);
+    swdb.setItemDone("bash-4.4.12-5.fc26.x86_64");
+    swdb.addConsoleOutputLine(1, "Foo");
+    swdb.addConsoleOutputLine(2, "Bar");
+
+    // the writes are buffered until the transaction ends
+    CPPUNIT_ASSERT(libdnf::Transaction(conn, id).getConsoleOutput().empty());
+
+    swdb.endTransaction(2, "def", TransactionState::DONE);
+    swdb.closeTransaction();
+
+    libdnf::Transaction trans(conn, id);
+    CPPUNIT_ASSERT_EQUAL(TransactionState::DONE, trans.getState());
+    auto items = trans.getItems();
+    CPPUNIT_ASSERT_EQUAL(static_cast< size_t >(1), items.size());
+    CPPUNIT_ASSERT_EQUAL(TransactionItemState::DONE, items[0]->getState());
+
+    auto output = trans.getConsoleOutput();
+    CPPUNIT_ASSERT_EQUAL(static_cast< size_t >(2), output.size());
+    CPPUNIT_ASSERT_EQUAL(1, output[0].first);
+    CPPUNIT_ASSERT_EQUAL(std::string("Foo"), output[0].second);
+    CPPUNIT_ASSERT_EQUAL(2, output[1].first);
+    CPPUNIT_ASSERT_EQUAL(std::string("Bar"), output[1].second);
+}
@@ -9,6 +9,7 @@
 class WorkflowTest : public CppUnit::TestCase {
     CPPUNIT_TEST_SUITE(WorkflowTest);
     CPPUNIT_TEST(testDefaultWorkflow);
+    CPPUNIT_TEST(testBatchedWrites);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -16,6 +17,7 @@ public:
     void tearDown() override;
 
     void testDefaultWorkflow();
+    void testBatchedWrites();
 
 private:
     std::shared_ptr< SQLite3 > conn;
@@ -0,0 +1,65 @@
+#include "Sqlite3Test.hpp"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(Sqlite3Test);
+
+static const char * const selectValue = "SELECT value FROM test WHERE id = ?";
+
+static void
+createTable(SQLite3 & db)
+{
+    db.exec("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);"
+            "INSERT INTO test VALUES (1, 'one'), (2, 'two');");
+}
+
+static std::string
+selectById(SQLite3 & db, int id)
+{
+    SQLite3::Query query(db, selectValue);
+    query.bindv(id);
+    CPPUNIT_ASSERT(query.step() == SQLite3::Statement::StepResult::ROW);
+    return query.get< std::string >("value");
+}
+
+void
+Sqlite3Test::setUp()
+{
+    db = std::make_shared< SQLite3 >(":memory:");
+    createTable(*db);
+}
+
+void
+Sqlite3Test::tearDown()
+{
+}
+
+void
+Sqlite3Test::testStatementReuse()
+{
+    // the second query runs on the cached statement, its bindings must be fresh
+    CPPUNIT_ASSERT_EQUAL(std::string("one"), selectById(*db, 1));
+    CPPUNIT_ASSERT_EQUAL(std::string("two"), selectById(*db, 2));
+
+    // the same SQL borrowed twice at once gets two statements
+    SQLite3::Query first(*db, selectValue);
+    first.bindv(1);
+    CPPUNIT_ASSERT(first.step() == SQLite3::Statement::StepResult::ROW);
+    CPPUNIT_ASSERT_EQUAL(std::string("two"), selectById(*db, 2));
+    CPPUNIT_ASSERT_EQUAL(std::string("one"), first.get< std::string >("value"));
+}
+
+void
+Sqlite3Test::testStatementBorrowedAcrossReopen()
+{
+    CPPUNIT_ASSERT_EQUAL(std::string("one"), selectById(*db, 1));
+    std::unique_ptr< SQLite3::Query > borrowed(new SQLite3::Query(*db, selectValue));
+
+    // close() finalizes the borrowed statement, releasing it must neither finalize it again
+    // nor hand it to the new connection
+    db->close();
+    db->open();
+    borrowed.reset();
+
+    createTable(*db);
+    CPPUNIT_ASSERT_EQUAL(std::string("two"), selectById(*db, 2));
+    CPPUNIT_ASSERT_EQUAL(std::string("one"), selectById(*db, 1));
+}
@@ -0,0 +1,26 @@
+#ifndef LIBDNF_SQLITE3_TEST_HPP
+#define LIBDNF_SQLITE3_TEST_HPP
+
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "libdnf/utils/sqlite3/Sqlite3.hpp"
+
+class Sqlite3Test : public CppUnit::TestCase {
+    CPPUNIT_TEST_SUITE(Sqlite3Test);
+    CPPUNIT_TEST(testStatementReuse);
+    CPPUNIT_TEST(testStatementBorrowedAcrossReopen);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() override;
+    void tearDown() override;
+
+    void testStatementReuse();
+    void testStatementBorrowedAcrossReopen();
+
+private:
+    std::shared_ptr< SQLite3 > db;
+};
+
+#endif // LIBDNF_SQLITE3_TEST_HPP